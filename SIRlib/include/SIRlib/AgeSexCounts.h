@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+
+namespace SIRlib {
+
+// Counts of people by sex and single year of age, for aggregate simulation of
+//   a compartment. Cells are indexed by 'Cell(sex, age)'. A Fenwick tree over
+//   the cells allows a person to be drawn uniformly from the compartment in
+//   O(log nCells).
+class AgeSexCounts {
+public:
+    using CellT  = unsigned int;
+    using CountT = long;
+
+    AgeSexCounts(void) : AgeSexCounts(0, 0) {};
+
+    // Creates empty counts for ages in [ageMin, ageMax] and two sexes
+    AgeSexCounts(unsigned int ageMin, unsigned int ageMax);
+
+    CellT NumCells(void) const { return (CellT)counts.size(); }
+
+    CellT Cell(int sex, unsigned int age) const {
+        return (CellT)sex * nAges + (age - ageMin);
+    }
+
+    int          CellSex(CellT cell) const { return (int)(cell / nAges); }
+    unsigned int CellAge(CellT cell) const { return ageMin + cell % nAges; }
+
+    CountT Get(CellT cell) const { return counts[cell]; }
+    CountT Total(void)     const { return total; }
+
+    // Adds 'n' (possibly negative) people to cell 'cell'
+    void Add(CellT cell, CountT n);
+
+    // Returns the cell of the person at position floor(u * Total()) in cell
+    //   order, which for 'u' uniform on [0, 1) is the cell of a person drawn
+    //   uniformly from the compartment. Requires Total() > 0.
+    CellT Sample(double u) const;
+
+    // Empties every cell
+    void Clear(void);
+
+private:
+    unsigned int ageMin;
+    unsigned int nAges;
+
+    CountT total;
+    std::vector<CountT> counts;
+
+    // Fenwick tree over 'counts', 1-indexed
+    std::vector<CountT> tree;
+    CellT topBit;
+};
+
+}
@@ -0,0 +1,464 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace SIRlib {
+
+// An event of the individual engine. Every event is fully described by its
+//   kind, its time, and the person it affects, so it is stored by value and
+//   run by a switch on 'kind' rather than through a closure. Recoveries are
+//   not events; they are held in a RecoveryStore.
+struct SIREvent {
+    enum class Kind : uint8_t {
+        Infection, FOIUpdate
+    };
+
+    double   t;   // Time of the event
+    uint32_t idx; // Index of the person affected; unused by FOIUpdate
+    Kind     kind;
+};
+
+// Event queue policies for BasicSIRSimulation. A queue holds SIREvents by
+//   value and hands them back in order of time. Of events of equal time,
+//   infections come before FOI updates, so that an update never draws again
+//   a person whose infection falls on its own time. A queue is constructed
+//   from the end of the run, 'tMax', before which almost every event falls.
+//
+// A queue provides:
+//   Queue(double tMax)
+//   void Schedule(const SIREvent &e)
+//   void ScheduleBulk(const SIREvent *events, size_t n)
+//   const SIREvent &Top(void)
+//   void Pop(void)
+//   bool Empty(void)
+//   void Clear(void)    drops every event, keeping storage for reuse
+//   void Release(void)  drops every event and frees storage
+
+// The recovery of person 'idx' at time 't'. Packed into 12 bytes, as
+//   there is one for every infective.
+#pragma pack(push, 4)
+struct Recovery {
+    double   t;
+    uint32_t idx;
+};
+#pragma pack(pop)
+
+// Orders a heap of events, or of any entries with a time 't', so that its
+//   front is the earliest entry. Events of equal time are ordered by kind.
+struct LaterEvent {
+    template <typename Entry>
+    bool operator()(const Entry &a, const Entry &b) const {
+        return a.t > b.t;
+    }
+
+    bool operator()(const SIREvent &a, const SIREvent &b) const {
+        return a.t > b.t || (a.t == b.t && a.kind > b.kind);
+    }
+};
+
+// Restores the heap order of 'heap' after entries were appended to its
+//   first 'old' entries, which form a heap. Sifting up each new entry costs
+//   O(log n) apiece, so a heapify of the whole array is done instead when the
+//   new entries are numerous.
+template <typename Entry>
+inline void RestoreHeap(std::vector<Entry> &heap, size_t old) {
+    size_t n = heap.size() - old;
+
+    if (n > old / 16)
+        std::make_heap(heap.begin(), heap.end(), LaterEvent{});
+    else
+        for (size_t i = old + 1; i <= heap.size(); i++)
+            std::push_heap(heap.begin(), heap.begin() + i, LaterEvent{});
+}
+
+// Binary min-heap of events on a contiguous array
+class HeapEventQueue {
+public:
+    explicit HeapEventQueue(double /*tMax*/ = 0) {}
+
+    void Schedule(const SIREvent &e) {
+        heap.push_back(e);
+        std::push_heap(heap.begin(), heap.end(), LaterEvent{});
+    }
+
+    // Schedules the 'n' events of 'events' together
+    void ScheduleBulk(const SIREvent *events, size_t n) {
+        size_t old = heap.size();
+
+        heap.insert(heap.end(), events, events + n);
+        RestoreHeap(heap, old);
+    }
+
+    // Returns the earliest event. The queue must not be empty.
+    const SIREvent &Top(void) const { return heap.front(); }
+
+    // Removes the earliest event. The queue must not be empty.
+    void Pop(void) {
+        std::pop_heap(heap.begin(), heap.end(), LaterEvent{});
+        heap.pop_back();
+    }
+
+    bool   Empty(void) const { return heap.empty(); }
+    size_t Size(void)  const { return heap.size(); }
+    void   Clear(void)       { heap.clear(); }
+    void   Release(void)     { std::vector<SIREvent>().swap(heap); }
+
+private:
+    std::vector<SIREvent> heap;
+};
+
+// Arena of fixed-size blocks of entries, owned by one queue. Blocks are
+//   carved from slabs of 'SlabBlocks' blocks and recycled through a free
+//   list, so a queue in steady state makes no calls to the heap. Every block
+//   is handed back at once by Reset(), and the slabs are freed by Free().
+template <typename Entry>
+class BlockArena {
+public:
+    static constexpr uint32_t BlockEntries = 128;
+    static constexpr size_t   SlabBlocks   = 64;
+
+    struct Block {
+        Block   *next;                 // Next block of the same list
+        uint32_t n;                    // Number of entries held
+        Entry    entries[BlockEntries];
+    };
+
+    BlockArena(void) : slabsInUse(0), used(0), freeList(nullptr) {}
+    ~BlockArena(void) { Free(); }
+
+    BlockArena(const BlockArena &) = delete;
+    BlockArena &operator=(const BlockArena &) = delete;
+
+    // Returns an empty block
+    Block *Allocate(void) {
+        Block *b = freeList;
+
+        if (b != nullptr)
+            freeList = b->next;
+        else {
+            if (slabsInUse == 0 || used == SlabBlocks) {
+                if (slabsInUse == slabs.size())
+                    slabs.push_back(new Block[SlabBlocks]);
+                slabsInUse += 1;
+                used = 0;
+            }
+            b = &slabs[slabsInUse - 1][used++];
+        }
+
+        b->next = nullptr;
+        b->n    = 0;
+        return b;
+    }
+
+    // Hands block 'b' back for reuse
+    void Release(Block *b) {
+        b->next  = freeList;
+        freeList = b;
+    }
+
+    // Hands every block back for reuse, keeping the slabs
+    void Reset(void) {
+        slabsInUse = 0;
+        used       = 0;
+        freeList   = nullptr;
+    }
+
+    // Hands every block back and frees the slabs
+    void Free(void) {
+        for (auto slab : slabs)
+            delete[] slab;
+        slabs.clear();
+
+        Reset();
+    }
+
+private:
+    std::vector<Block *> slabs;
+    size_t slabsInUse; // Number of slabs blocks have been carved from
+    size_t used;       // Number of blocks carved from the last of them
+    Block *freeList;
+};
+
+// Calendar queue of entries with a time 't', with one bucket per
+//   'bucketWidth' days of [0, tMax) and a last bucket for entries at or after
+//   'tMax'. Scheduling appends to a list of arena blocks in O(1). A bucket is
+//   only moved into a heap when it becomes the earliest non-empty one, so
+//   entries are ordered within a day's entries rather than among every
+//   pending entry. Entries must not be scheduled before the time of the last
+//   entry popped.
+template <typename Entry>
+class CalendarQueue {
+public:
+    using Arena = BlockArena<Entry>;
+
+    explicit CalendarQueue(double tMax, double bucketWidth = 1) :
+        width(bucketWidth),
+        buckets((size_t)std::ceil(tMax / bucketWidth) + 1, nullptr),
+        cur(0), loaded(false), size(0) {}
+
+    void Schedule(const Entry &e) {
+        size_t b = Bucket(e.t);
+
+        if (b == cur && loaded) {
+            heap.push_back(e);
+            std::push_heap(heap.begin(), heap.end(), LaterEvent{});
+        } else
+            Append(e);
+
+        size += 1;
+    }
+
+    // Schedules the 'n' entries of 'entries' together. Those falling in the
+    //   current bucket are merged into its heap at once.
+    void ScheduleBulk(const Entry *entries, size_t n) {
+        size_t old = heap.size();
+
+        for (size_t i = 0; i < n; i++) {
+            if (loaded && Bucket(entries[i].t) == cur)
+                heap.push_back(entries[i]);
+            else
+                Append(entries[i]);
+        }
+
+        RestoreHeap(heap, old);
+        size += n;
+    }
+
+    // Returns the earliest entry. The queue must not be empty.
+    const Entry &Top(void) {
+        Advance();
+        return heap.front();
+    }
+
+    // Removes the earliest entry. The queue must not be empty.
+    void Pop(void) {
+        Advance();
+
+        std::pop_heap(heap.begin(), heap.end(), LaterEvent{});
+        heap.pop_back();
+
+        size -= 1;
+    }
+
+    bool   Empty(void) const { return size == 0; }
+    size_t Size(void)  const { return size; }
+
+    void Clear(void) {
+        std::fill(buckets.begin(), buckets.end(), nullptr);
+        arena.Reset();
+        heap.clear();
+
+        cur    = 0;
+        loaded = false;
+        size   = 0;
+    }
+
+    void Release(void) {
+        Clear();
+        arena.Free();
+        std::vector<Entry>().swap(heap);
+    }
+
+private:
+    double width;
+
+    // Last block of the list of entries of each bucket
+    std::vector<typename Arena::Block *> buckets;
+    Arena arena;
+
+    // Entries of bucket 'cur', once loaded, as a heap
+    std::vector<Entry> heap;
+
+    size_t cur;  // Index of the earliest bucket which may be non-empty
+    bool loaded; // Whether bucket 'cur' has been moved into 'heap'
+    size_t size; // Number of entries in the queue
+
+    // Returns the bucket of an entry at time 't'. Entries in the past go to
+    //   the current bucket.
+    size_t Bucket(double t) const {
+        if (!(t >= (double)cur * width))
+            return cur;
+
+        size_t b = std::max(cur, (size_t)(t / width));
+        return b < buckets.size() ? b : buckets.size() - 1;
+    }
+
+    // Appends 'e' to the list of blocks of its bucket
+    void Append(const Entry &e) {
+        size_t b = Bucket(e.t);
+        typename Arena::Block *head = buckets[b];
+
+        if (head == nullptr || head->n == Arena::BlockEntries) {
+            typename Arena::Block *block = arena.Allocate();
+            block->next = head;
+            buckets[b]  = head = block;
+        }
+        head->entries[head->n++] = e;
+    }
+
+    // Moves the earliest non-empty bucket into 'heap', handing its blocks
+    //   back to the arena
+    void Advance(void) {
+        while (heap.empty()) {
+            if (loaded)
+                cur += 1;
+
+            for (auto block = buckets[cur]; block != nullptr; ) {
+                auto next = block->next;
+
+                heap.insert(heap.end(), block->entries, block->entries + block->n);
+                arena.Release(block);
+                block = next;
+            }
+            buckets[cur] = nullptr;
+
+            std::make_heap(heap.begin(), heap.end(), LaterEvent{});
+            loaded = true;
+        }
+    }
+};
+
+// Calendar queue of events, bucketed by day
+using CalendarEventQueue = CalendarQueue<SIREvent>;
+using EventArena         = BlockArena<SIREvent>;
+
+// Store of the pending recoveries of the individual engine. Every infective
+//   has one, so they are kept apart from the event queue as 12-byte entries
+//   bucketed by day.
+using RecoveryStore = CalendarQueue<Recovery>;
+
+// Radix heap of events keyed on integer ticks of 'TicksPerDay' ticks per
+//   day. Times are rounded to the nearest tick when scheduled, and handed
+//   back rounded, so events meant for the same time, such as those at
+//   't + deltaT', compare equal. The lowest bit of a key holds the kind of
+//   the event, so that events on the same tick pop in order of kind rather
+//   than in the last-in first-out order of a bucket. The popped keys never
+//   decrease, so an event is kept in the bucket of the highest bit in which
+//   its key differs from the last key popped, and only moves to lower
+//   buckets: each event is moved at most 64 times, and Schedule() is O(1).
+//   Events must not be scheduled before the time of the last event popped.
+class RadixEventQueue {
+public:
+    using Ticks = uint64_t;
+
+    static constexpr double TicksPerDay = 1e6;
+
+    explicit RadixEventQueue(double /*tMax*/ = 0) : last(0), size(0) {}
+
+    // Converts time 't' to the nearest tick
+    static Ticks ToTicks(double t) {
+        return t > 0 ? (Ticks)std::llround(t * TicksPerDay) : 0;
+    }
+
+    void Schedule(const SIREvent &e) {
+        Ticks key = std::max(last, Key(e));
+
+        buckets[Bucket(key)].push_back(Item{key, e.idx, e.kind});
+        size += 1;
+    }
+
+    void ScheduleBulk(const SIREvent *events, size_t n) {
+        for (size_t i = 0; i < n; i++)
+            Schedule(events[i]);
+    }
+
+    // Returns the earliest event. The queue must not be empty.
+    const SIREvent &Top(void) {
+        Refill();
+
+        const Item &item = buckets[0].back();
+        top = SIREvent{(double)(item.key >> 1) / TicksPerDay, item.idx, item.kind};
+
+        return top;
+    }
+
+    // Removes the earliest event. The queue must not be empty.
+    void Pop(void) {
+        Refill();
+
+        buckets[0].pop_back();
+        size -= 1;
+    }
+
+    bool   Empty(void) const { return size == 0; }
+    size_t Size(void)  const { return size; }
+
+    void Clear(void) {
+        for (auto &bucket : buckets)
+            bucket.clear();
+
+        last = 0;
+        size = 0;
+    }
+
+    void Release(void) {
+        for (auto &bucket : buckets)
+            std::vector<Item>().swap(bucket);
+
+        last = 0;
+        size = 0;
+    }
+
+private:
+    // Returns the key of event 'e': its tick, then its kind
+    static Ticks Key(const SIREvent &e) {
+        return (ToTicks(e.t) << 1) | (Ticks)(e.kind == SIREvent::Kind::FOIUpdate);
+    }
+
+    // An event as stored, with its key
+    struct Item {
+        Ticks          key;
+        uint32_t       idx;
+        SIREvent::Kind kind;
+    };
+
+    // Bucket 0 holds the events at tick 'last'; bucket 'b' > 0 those whose
+    //   key first differs from 'last' in bit 'b - 1'
+    std::vector<Item> buckets[65];
+
+    Ticks  last; // Key of the last event popped
+    size_t size; // Number of events in the queue
+
+    SIREvent top; // The event last returned by Top()
+
+    size_t Bucket(Ticks key) const {
+        Ticks diff = key ^ last;
+
+        if (diff == 0)
+            return 0;
+#if defined(__GNUC__)
+        return 64 - __builtin_clzll(diff);
+#else
+        size_t b = 0;
+        for (; diff != 0; diff >>= 1)
+            b += 1;
+        return b;
+#endif
+    }
+
+    // Makes bucket 0 non-empty by moving 'last' to the smallest key of the
+    //   first non-empty bucket and spreading that bucket over lower ones
+    void Refill(void) {
+        if (!buckets[0].empty())
+            return;
+
+        size_t b = 1;
+        while (buckets[b].empty())
+            b += 1;
+
+        Ticks smallest = buckets[b][0].key;
+        for (const Item &item : buckets[b])
+            smallest = std::min(smallest, item.key);
+
+        last = smallest;
+
+        for (const Item &item : buckets[b])
+            buckets[Bucket(item.key)].push_back(item);
+        buckets[b].clear();
+    }
+};
+
+}
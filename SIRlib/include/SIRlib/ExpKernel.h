@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+
+namespace SIRlib {
+
+// Instruction sets the exponential kernel can be dispatched to
+enum class SIMDLevel {
+    Scalar, SSE2, AVX2
+};
+
+// Returns the widest instruction set supported by the running CPU.
+SIMDLevel DetectSIMDLevel(void);
+
+// Transforms 'n' uniform variates 'u' on (0, 1] into exponential variates of
+//   rate 'rate', writing -log(u[i]) / rate into 'out[i]'. 'u' and 'out' may
+//   be the same array. Dispatches at runtime to the widest instruction set
+//   supported by the CPU.
+void ExponentialFromUniforms(const double *u, double *out, size_t n, double rate);
+
+// As above, but forces the kernel for instruction set 'level'. Throws
+//   out_of_range if 'level' is not supported by the running CPU.
+void ExponentialFromUniforms(SIMDLevel level, const double *u, double *out, \
+                             size_t n, double rate);
+
+}
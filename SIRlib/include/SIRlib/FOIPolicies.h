@@ -0,0 +1,17 @@
+#pragma once
+
+namespace SIRlib {
+
+// FOI policies for BasicSIRSimulation. A FOI policy gives the force of
+//   infection, i.e. the rate at which each susceptible is infected, through
+//
+//   static double ForceOfInfection(double lambda, double nInfected, double nPeople)
+
+// Frequency-dependent transmission: lambda * I / N
+struct FrequencyDependentFOI {
+    static double ForceOfInfection(double lambda, double nInfected, double nPeople) {
+        return lambda * (nInfected / nPeople);
+    }
+};
+
+}
@@ -17,17 +17,21 @@ enum class Sex {
 
 using Age = unsigned int;
 
+// Largest age of an individual. PopulationStore keeps ages in one byte.
+const Age MaxAge = 255;
+
 using Individual = struct {
     SIRlib::HealthState  hs;
     SIRlib::Sex          sex;
     SIRlib::Age          age;
 };
 
-auto sexN = [](SIRlib::Sex s) { switch(s) { case Sex::Male   : return 0;
-                                            case Sex::Female : return 1; } };
+inline int sexN(SIRlib::Sex s) { switch(s) { case Sex::Male   : return 0;
+                                             case Sex::Female : return 1; }
+                                return 0; }
 
-auto Nsex = [](long n) { if (n == 0) return Sex::Male;
-                         else        return Sex::Female; };
+inline Sex Nsex(long n) { if (n == 0) return Sex::Male;
+                          else        return Sex::Female; }
 
 inline Individual newIndividual(RNG *rng, UniformDiscrete *ageDist,
                          Bernoulli *sexDist, SIRlib::HealthState hs) {
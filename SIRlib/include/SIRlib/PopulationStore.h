@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Individual.h"
+
+namespace SIRlib {
+
+// Struct-of-arrays store of the members of a population. Each person takes
+//   one byte of health state, one byte of age, and one bit of sex, in three
+//   contiguous arrays, rather than a whole Individual. People are read one
+//   at a time through the accessors: the FOI sweeps walk the simulation's
+//   index of susceptibles rather than scanning every health state, so the
+//   layout saves memory, not sweep time. Ages must be <= MaxAge.
+class PopulationStore {
+public:
+    using IndexT = unsigned int;
+
+    IndexT Size(void) const { return (IndexT)states.size(); }
+
+    void Reserve(IndexT n) {
+        states.reserve(n);
+        ages.reserve(n);
+        sexes.reserve((n + 63) / 64);
+    }
+
+    void Clear(void) {
+        states.clear();
+        ages.clear();
+        sexes.clear();
+    }
+
+    // Appends 'idv' to the store, returning their index
+    IndexT PushBack(const Individual &idv) {
+        IndexT i = Size();
+
+        if (i % 64 == 0)
+            sexes.push_back(0);
+
+        states.push_back((uint8_t)idv.hs);
+        ages.push_back((uint8_t)idv.age);
+        sexes[i / 64] |= (uint64_t)sexN(idv.sex) << (i % 64);
+
+        return i;
+    }
+
+    HealthState GetHealthState(IndexT i) const { return (HealthState)states[i]; }
+    Sex         GetSex(IndexT i)         const { return Nsex((sexes[i / 64] >> (i % 64)) & 1); }
+    Age         GetAge(IndexT i)         const { return (Age)ages[i]; }
+
+    void SetHealthState(IndexT i, HealthState hs) { states[i] = (uint8_t)hs; }
+
+    // Returns a copy of the attributes of person 'i'
+    Individual Get(IndexT i) const {
+        Individual idv;
+
+        idv.hs  = GetHealthState(i);
+        idv.sex = GetSex(i);
+        idv.age = GetAge(i);
+
+        return idv;
+    }
+
+private:
+    std::vector<uint8_t>  states;
+    std::vector<uint8_t>  ages;
+    std::vector<uint64_t> sexes;
+};
+
+}
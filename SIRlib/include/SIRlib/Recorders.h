@@ -0,0 +1,397 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <PrevalenceTimeSeries.h>
+#include <PrevalencePyramidTimeSeries.h>
+#include <IncidenceTimeSeries.h>
+#include <IncidencePyramidTimeSeries.h>
+#include <TimeStatistic.h>
+#include <DiscreteTimeStatistic.h>
+#include <ContinuousTimeStatistic.h>
+
+#include "Individual.h"
+
+using namespace std;
+using namespace SimulationLib;
+
+namespace SIRlib {
+
+enum class SIRData {
+    Susceptible, Infected, Recovered, Infections, Recoveries
+};
+
+// Set of SIRData fields, one bit per field
+using SIRDataMask = unsigned int;
+
+// Returns the bit of 'field' in a SIRDataMask
+constexpr SIRDataMask SIRDataBit(SIRData field) {
+    return 1u << (unsigned int)field;
+}
+
+// Every SIRData field
+const SIRDataMask AllSIRData = 0x1F;
+
+// Age breaks of the case profile by age. An age equal to a break starts the
+//   next group.
+const double ProfileAgeBreaks[] = {4, 18, 24, 40};
+
+// Recorder policies for BasicSIRSimulation. A recorder owns the datastores
+//   of one simulation. The simulation calls Record<D>() on every change of
+//   state, with the field 'D' known at compile time, so each call resolves to
+//   the updates of that field alone and can be inlined.
+//
+// A recorder provides:
+//   Recorder(tMax, pLength, ageBreaks, outputs)
+//   template <SIRData D> bool Record(int t, int sex, Age age, int increment)
+//   bool RecordTotalAge(Age age, int n)
+//   void Close(void)
+//   template <typename T> T *GetData(SIRData field)
+
+// Records every time series, time statistic and pyramid of the simulation,
+//   and the case profile by age.
+//
+// All results of a run are kept in one contiguous block of ints, allocated
+//   once in the constructor, with a fixed layout:
+//
+//   [period][column]                  change of each field in the period
+//   [period][column][sex][age group]  the same, by sex and pyramid age group
+//   [case-profile age group]          infections over the run
+//   [case-profile age group]          people in the population
+//   [day][column]                     change of each field on the day
+//
+// with periods of 'pLength' days in [0, tMax / pLength], the days of those
+//   periods, and one column for each kept field, in the order of SIRData.
+//   Record<D>() is one add into the [period][column][sex][age group] cell
+//   and one into the [day][column] cell. The [period][column] totals are
+//   summed on Close(). Exporters can read the block directly through Data(),
+//   finding the column of a field with Column().
+//
+// GetData() builds the SimulationLib time series, statistic and pyramid of
+//   a field from the block the first time they are asked for, so a run that
+//   is only read through the block allocates none of them. The time series
+//   is replayed a day at a time, so its statistic steps on every day the
+//   field changed, as when each change was recorded on its day. GetData()
+//   throws before Close(), as the block is still changing.
+//
+// Only the fields in 'outputs' are kept, and the block has no room for the
+//   others. Record<D>() ignores them, Total() and ByAgeGroup() return 0 for
+//   them, and GetData returns nullptr for them. The case profile belongs to
+//   Infections.
+class FullRecorder {
+public:
+    using uint = unsigned int;
+
+    static const int nFields = 5;
+    static const int nSexes  = 2;
+
+    FullRecorder(uint tMax, uint pLength, vector<double> ageBreaks,
+                 SIRDataMask outputs = AllSIRData);
+    ~FullRecorder(void);
+
+    // Increments field 'D' by 'increment' at time 't' for people of sex
+    //   'sex' and age 'age'. Returns false if 't' is past the last period.
+    template <SIRData D>
+    bool Record(int t, int sex, Age age, int increment);
+
+    // Adds 'n' people of age 'age' to the age profile of the population
+    bool RecordTotalAge(Age age, int n) {
+        populationProfile[profileAgeGroup[age]] += n;
+        return true;
+    }
+
+    // Sums the totals of each period
+    void Close(void);
+
+    // Returns the datastore of type 'T' for 'field', or nullptr if there is
+    //   none
+    template <typename T>
+    T *GetData(SIRData field);
+
+    // Returns the result block, and its size in ints
+    const int *Data(void) const { return block.data(); }
+    size_t Size(void) const { return block.size(); }
+
+    uint NumPeriods(void)      const { return nPeriods; }
+    int  NumAgeGroups(void)    const { return nAgeGroups; }
+    int  NumProfileGroups(void) const { return nProfileGroups; }
+    int  NumColumns(void)      const { return nColumns; }
+
+    // Returns the column of 'field' in the block, or -1 if it is not kept
+    int Column(SIRData field) const { return column[(int)field]; }
+
+    // Returns the change of 'field' in period 'period', after Close()
+    int Total(SIRData field, uint period) const {
+        int c = column[(int)field];
+        return c < 0 ? 0 : totals[period * nColumns + c];
+    }
+
+    // Returns the change of 'field' in period 'period' for people of sex
+    //   'sex' in age group 'group'
+    int ByAgeGroup(SIRData field, uint period, int sex, int group) const {
+        int c = column[(int)field];
+        return c < 0 ? 0 : byAgeGroup[((period * nColumns + c) * nSexes + sex)
+                                      * nAgeGroups + group];
+    }
+
+    // Returns the number of infections over the run in age group 'group' of
+    //   the case profile
+    int InfectionsByAgeGroup(int group) const {
+        return infectionsProfile[group];
+    }
+
+    // Returns the number of people in age group 'group' of the case profile
+    int PopulationByAgeGroup(int group) const {
+        return populationProfile[group];
+    }
+
+private:
+    uint tMax;
+    uint pLength;
+    uint nPeriods;
+    uint nDays;
+    SIRDataMask outputs;
+    bool closed;
+
+    // Column of each field in the block, or -1 if it is not kept, and the
+    //   number of columns
+    int column[nFields];
+    int nColumns;
+
+    vector<double> ageBreaks;
+    vector<double> profileAgeBreaks;
+    int nAgeGroups;
+    int nProfileGroups;
+
+    // Age group of every age in [0, MaxAge], in the pyramids and in the case
+    //   profile. Built once from the age breaks, so recording a change is a
+    //   table lookup rather than a search of the breaks.
+    vector<uint8_t> ageGroup;
+    vector<uint8_t> profileAgeGroup;
+
+    // The result block, and the start of each of its parts
+    vector<int> block;
+    int *totals;
+    int *byAgeGroup;
+    int *infectionsProfile;
+    int *populationProfile;
+    int *dailyTotals;
+
+    // Datastores built by GetData(), indexed by field
+    TimeSeries<int>   *series[nFields];
+    TimeStatistic     *statistics[nFields];
+    PyramidTimeSeries *pyramids[nFields];
+    PyramidData<double> *InfectionsAgePercent;
+
+    // Builds the time series, statistic and pyramid of 'field', if it is
+    //   kept and they have not been built yet
+    void BuildField(SIRData field);
+
+    // Builds the percent of infections in each age group of the case profile
+    void CalculateInfectionAgePercent(void);
+};
+
+template <SIRData D>
+inline bool FullRecorder::Record(int t, int sex, Age age, int increment) {
+    int c = column[(int)D];
+    if (c < 0)
+        return true;
+
+    uint period = (uint)t / pLength;
+    if (period >= nPeriods)
+        return false;
+
+    byAgeGroup[((period * nColumns + c) * nSexes + sex) * nAgeGroups
+               + ageGroup[age]] += increment;
+    dailyTotals[t * nColumns + c] += increment;
+
+    // Increase number of infections in age group to calculate percentages
+    //   later on
+    if (D == SIRData::Infections)
+        infectionsProfile[profileAgeGroup[age]] += increment;
+
+    return true;
+}
+
+// Receives the results of a simulation one period at a time, as each
+//   period closes. See StreamingRecorder.
+class PeriodSink {
+public:
+    virtual ~PeriodSink(void) {}
+
+    // Called once for every period, in order. 'totals' holds each field in
+    //   period 'period', in the order of SIRData, and 'byAgeGroup' the same
+    //   by [field][sex][age group], with 'nAgeGroups' age groups. Like the
+    //   prevalence and incidence time series, Susceptible, Infected and
+    //   Recovered are the counts at the end of the period, and Infections
+    //   and Recoveries the change over the period. Both are only valid
+    //   during the call.
+    virtual void ClosePeriod(unsigned int period, const int *totals,
+                             const int *byAgeGroup, int nAgeGroups) = 0;
+};
+
+// Streams the results of the simulation to a PeriodSink instead of keeping
+//   them, so memory does not grow with 'tMax'. Changes are counted in a ring
+//   of 'nSlots' periods with the layout of one period of FullRecorder's
+//   [period][field][sex][age group] tensor. When a change arrives for a
+//   period past the end of the ring, the oldest periods are passed to the
+//   sink and their slots reused. Close() passes the rest, up to the last
+//   period. A change for a period already passed is dropped, and Record()
+//   returns false. The count of each prevalence cell is kept apart from the
+//   ring and carried from one period to the next, so the sink is given
+//   counts for the prevalence fields.
+//
+// Only the fields in 'outputs' are counted, the others are zero. The case
+//   profile of infections and of the population is kept and read with
+//   InfectionsByAgeGroup() and PopulationByAgeGroup(). GetData returns the
+//   percent of infections in each age group of the case profile after
+//   Close(), like FullRecorder, and nullptr for everything else.
+class StreamingRecorder {
+public:
+    using uint = unsigned int;
+
+    static const int  nFields = 5;
+    static const int  nSexes  = 2;
+    static const uint nSlots  = 4;
+
+    StreamingRecorder(uint tMax, uint pLength, vector<double> ageBreaks,
+                      SIRDataMask outputs = AllSIRData);
+    ~StreamingRecorder(void);
+
+    // Sets the sink receiving each period. Without one, periods are
+    //   discarded. Must be called before Run().
+    void SetSink(PeriodSink *_sink) { sink = _sink; }
+
+    template <SIRData D>
+    bool Record(int t, int sex, Age age, int increment);
+
+    // Adds 'n' people of age 'age' to the age profile of the population
+    bool RecordTotalAge(Age age, int n) {
+        populationProfile[profileAgeGroup[age]] += n;
+        return true;
+    }
+
+    // Passes every period not yet passed to the sink
+    void Close(void);
+
+    template <typename T>
+    T *GetData(SIRData field) { return nullptr; }
+
+    // Returns the number of infections over the run in age group 'group' of
+    //   the case profile
+    int InfectionsByAgeGroup(int group) const {
+        return infectionsProfile[group];
+    }
+
+    // Returns the number of people in age group 'group' of the case profile
+    int PopulationByAgeGroup(int group) const {
+        return populationProfile[group];
+    }
+
+private:
+    uint pLength;
+    uint nPeriods;
+    SIRDataMask outputs;
+    PeriodSink *sink;
+    bool closed;
+
+    int nAgeGroups;
+    vector<double> profileAgeBreaks;
+    vector<uint8_t> ageGroup;
+    vector<uint8_t> profileAgeGroup;
+
+    // Changes of the periods in [first, first + nSlots), period 'p' in slot
+    //   'p % nSlots', the count of every [field][sex][age group] cell at the
+    //   end of period 'first' - 1, and the case profile
+    vector<int> ring;
+    uint first;
+    vector<int> levels;
+    vector<int> infectionsProfile;
+    vector<int> populationProfile;
+
+    PyramidData<double> *InfectionsAgePercent;
+
+    // Passes the periods before 'until' to the sink and clears their slots
+    void ClosePeriods(uint until);
+};
+
+template <SIRData D>
+inline bool StreamingRecorder::Record(int t, int sex, Age age, int increment) {
+    if (!(outputs & SIRDataBit(D)))
+        return true;
+
+    uint period = (uint)t / pLength;
+
+    // Periods before 'first' wrap around to large offsets too
+    if (period - first >= nSlots) {
+        if (period < first || period >= nPeriods)
+            return false;
+        ClosePeriods(period + 1 - nSlots);
+    }
+
+    ring[(((period % nSlots) * nFields + (int)D) * nSexes + sex) * nAgeGroups
+         + ageGroup[age]] += increment;
+
+    if (D == SIRData::Infections)
+        infectionsProfile[profileAgeGroup[age]] += increment;
+
+    return true;
+}
+
+template <>
+PyramidData<double> *StreamingRecorder::GetData<PyramidData<double>>(SIRData field);
+
+// Records only the Infections time series and its statistic, for runs such
+//   as calibration that need nothing else. Every other field is ignored.
+//   Infections are summed while they stay in one period and recorded as
+//   one change, at the time of the last of them, when one arrives for
+//   another period or on Close(). 'outputs' is ignored.
+class InfectionsRecorder {
+public:
+    using uint = unsigned int;
+
+    InfectionsRecorder(uint tMax, uint pLength, vector<double> ageBreaks,
+                       SIRDataMask outputs = AllSIRData);
+    ~InfectionsRecorder(void);
+
+    template <SIRData D>
+    bool Record(int t, int sex, Age age, int increment) { return true; }
+
+    bool RecordTotalAge(Age age, int n) { return true; }
+
+    void Close(void);
+
+    template <typename T>
+    T *GetData(SIRData field);
+
+private:
+    IncidenceTimeSeries<int> *Infections;
+    DiscreteTimeStatistic    *InfectionsSx;
+
+    int pLength;
+
+    // Infections of the current period, not yet recorded
+    int pending;
+    int pendingPeriod;
+    int pendingTime;
+
+    bool Flush(void);
+};
+
+template <>
+inline bool InfectionsRecorder::Record<SIRData::Infections>(int t, int sex, Age age, int increment) {
+    bool success = true;
+    int period   = t / pLength;
+
+    if (period != pendingPeriod) {
+        success       = Flush();
+        pendingPeriod = period;
+    }
+    pendingTime = t;
+    pending    += increment;
+
+    return success;
+}
+
+}
@@ -1,24 +1,25 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <memory>
 #include <vector>
 
-#include <PrevalenceTimeSeries.h>
-#include <PrevalencePyramidTimeSeries.h>
-#include <IncidenceTimeSeries.h>
-#include <IncidencePyramidTimeSeries.h>
-#include <TimeStatistic.h>
-#include <DiscreteTimeStatistic.h>
-#include <ContinuousTimeStatistic.h>
-
 #include <RNG.h>
 #include <Bernoulli.h>
 #include <UniformDiscrete.h>
 #include <Exponential.h>
-#include <EventQueue.h>
+#include <Uniform.h>
+#include <Binomial.h>
 
 #include "Individual.h"
+#include "ExpKernel.h"
+#include "AgeSexCounts.h"
+#include "PopulationStore.h"
+#include "Recorders.h"
+#include "FOIPolicies.h"
+#include "EventQueues.h"
+#include "ThreadPool.h"
 
 using namespace std;
 using namespace SimulationLib;
@@ -26,11 +27,126 @@ using namespace StatisticalDistributions;
 
 namespace SIRlib {
 
-enum class SIRData {
-    Susceptible, Infected, Recovered, Infections, Recoveries
+// Method used by the FOIUpdateEvent to decide who is infected during a step.
+//
+// PerIndividual:
+//   draws an exponential time-to-infection for every susceptible, and
+//   infects those whose time falls within the step.
+// Binomial:
+//   draws the number of new infections in the step from
+//   Binomial(S, 1 - exp(-FOI * deltaT)), picks that many susceptibles
+//   without replacement, and infects each at a uniform offset into the step.
+enum class FOIMode {
+    PerIndividual, Binomial
+};
+
+// Engine used by BasicSIRSimulation::Run.
+//
+// Individual:
+//   simulates every member of the population, with infections scheduled on an
+//   event queue, recoveries in a store of recoveries, and a force of
+//   infection updated every deltaT.
+// Gillespie:
+//   simulates only the counts of susceptibles and infectives by age and sex,
+//   with Gillespie's direct method. Each event draws only the age and sex of
+//   the person it affects. Exact in continuous time and uses no per-person
+//   memory.
+// TauLeaping:
+//   simulates the same counts as Gillespie, but advances by leaps in which
+//   the numbers of infections and recoveries in each age and sex cell are
+//   drawn from binomial distributions. The leap size is chosen so that the
+//   expected relative change in S and I, and the expected numbers of
+//   infections and of recoveries relative to I, stay below a bound (see
+//   SetTauLeapEpsilon). Falls back to exact Gillespie steps whenever a leap
+//   would cover only a few events, e.g. when counts are small.
+// Hybrid:
+//   runs the Individual engine while infectives are few, switches to
+//   TauLeaping once their number reaches an upper threshold, and switches
+//   back once it falls to a lower threshold (see SetHybridThresholds). On
+//   switching back, the health states of the Population are rebuilt from the
+//   aggregate counts and recoveries are rescheduled.
+// Parallel:
+//   runs the Individual engine with the population split into partitions
+//   (see SetPartitions), each with its own event queue, store of recoveries
+//   and RNG. Between FOI updates the events of different people are
+//   independent, so the partitions run each step on their own threads and
+//   only synchronize at the next update, where their infections and
+//   recoveries are recorded in order of time and the number of infectives
+//   is brought up to date. If the last infective recovered during the step,
+//   the transitions after their recovery are discarded and the run ends, as
+//   in Individual. Results depend on the seed and the number of partitions,
+//   not on the number of threads. Run() throws if SetLazyPopulation(true)
+//   was called.
+enum class RunMode {
+    Individual, Gillespie, TauLeaping, Hybrid, Parallel
 };
 
-class SIRSimulation {
+// A switch of RunMode::Hybrid between its engines
+struct HandOver {
+    double       t;           // Time of the switch
+    unsigned int nInfected;   // Infectives at the switch
+    bool         toAggregate; // Whether it switched to tau-leaping, or back
+};
+
+// An FOI update of the individual engines
+struct FOIStep {
+    double       t;         // Time of the update
+    double       length;    // Length of the step it begins
+    unsigned int nInfected; // Infectives at the update
+};
+
+// Work done by the engines of a BasicSIRSimulation over its last Run(), to
+//   check and tune them (see GetRunStats).
+struct RunStats {
+    // FOI updates of the individual engines, in order
+    vector<FOIStep> foiSteps;
+
+    // Susceptibles drawn for by FOI updates. FOIMode::PerIndividual draws a
+    //   time to infection for every susceptible; FOIMode::Binomial and a
+    //   lazy population only draw the people infected.
+    uint64_t foiDraws = 0;
+
+    // Events simulated exactly by Gillespie's direct method, one per step
+    uint64_t gillespieSteps = 0;
+
+    // Leaps of tau-leaping. Over each, the expected relative change in S and
+    //   in I is held to SetTauLeapEpsilon's epsilon / 2, and the expected
+    //   infections and recoveries to epsilon times I, unless counts are so
+    //   small that these allow less than one event. The largest of each over
+    //   the leaps taken.
+    uint64_t tauLeaps        = 0;
+    double   maxLeapChange   = 0;
+    double   maxLeapTurnover = 0;
+
+    // Switches of RunMode::Hybrid between its engines, in order
+    vector<HandOver> handOvers;
+
+    // Members created in the population. Everyone, unless the population is
+    //   lazy (see SetLazyPopulation).
+    uint64_t peopleCreated = 0;
+};
+
+// An SIR simulation, with its recording, force of infection and event queue
+//   chosen at compile time by policies.
+//
+// RecorderPolicy:
+//   owns the datastores and records each change of state (see Recorders.h).
+//   FullRecorder records everything; InfectionsRecorder only Infections.
+// FOIPolicy:
+//   computes the force of infection from the number of infectives (see
+//   FOIPolicies.h).
+// QueuePolicy:
+//   queue holding the scheduled events of the individual engine (see
+//   EventQueues.h). CalendarEventQueue buckets events by day;
+//   HeapEventQueue is a binary heap; RadixEventQueue is a radix heap on
+//   integer ticks.
+//
+// The combinations aliased below are instantiated in SIRlib.cpp; other
+//   combinations must be instantiated there too.
+template <typename RecorderPolicy = FullRecorder,
+          typename FOIPolicy      = FrequencyDependentFOI,
+          typename QueuePolicy    = CalendarEventQueue>
+class BasicSIRSimulation {
 public:
 
     using uint    = unsigned int;
@@ -38,8 +154,7 @@ public:
     using AgeT    = uint;
     using DayT    = double;
 
-    using EQ = EventQueue<DayT, bool>;
-    using EventFunc = EQ::EventFunc;
+    using EQ = QueuePolicy;
 
     // Creates a new SIRSimulation.
     //
@@ -52,7 +167,7 @@ public:
     // ageMin:
     //   minimum age of an individual (uint) unit: [years]
     // ageMax:
-    //   maximum age of an individual (uint | >= ageMin) unit: [years]
+    //   maximum age of an individual (uint | >= ageMin, <= MaxAge) unit: [years]
     // ageBreak:
     //   interval between age breaks of population (uint | > 1, < (ageMax - ageMin)) unit: [years]
     // tMax:
@@ -61,21 +176,103 @@ public:
     //   timestep (uint | >= 1, <= tMax) unit: [days]
     // pLength:
     //   length of one data-aggregation period (uint | > 0, < tMax) unit: [days]
-    SIRSimulation(RNG *rng, double _lambda, double _gamma, uint _nPeople, \
-                  uint _ageMin, uint _ageMax, uint _ageBreak,    \
-                  uint _tMax, uint _deltaT,                          \
-                  uint _pLength);
+    // outputs:
+    //   fields whose datastores are kept (SIRDataMask). GetData returns
+    //   nullptr for the others. Defaults to every field.
+    BasicSIRSimulation(RNG *rng, double _lambda, double _gamma, uint _nPeople, \
+                       uint _ageMin, uint _ageMax, uint _ageBreak,    \
+                       uint _tMax, uint _deltaT,                          \
+                       uint _pLength, SIRDataMask _outputs = AllSIRData);
 
     // Currently buggy. Frees memory associated with the simulation
-    ~SIRSimulation(void);
+    ~BasicSIRSimulation(void);
+
+    // Selects how new infections are drawn on each FOI update. Must be
+    //   called before Run(). Defaults to FOIMode::PerIndividual.
+    void SetFOIMode(FOIMode mode);
+
+    // Selects the engine used by Run(). Must be called before Run(). Defaults
+    //   to RunMode::Individual.
+    void SetRunMode(RunMode mode);
+
+    // Sets the bound on the expected relative change in S and I during one
+    //   leap of RunMode::TauLeaping (double | > 0, < 1). Smaller values give
+    //   shorter, more accurate leaps. Defaults to 0.03.
+    void SetTauLeapEpsilon(double epsilon);
+
+    // Sets the numbers of infectives at which RunMode::Hybrid switches from
+    //   the individual engine to tau-leaping ('toAggregate'), and back again
+    //   ('toIndividual' | < toAggregate). Defaults to 1000 and 100.
+    void SetHybridThresholds(PeopleT toAggregate, PeopleT toIndividual);
+
+    // Enables lazy materialization of the population. The initial numbers of
+    //   susceptibles by age and sex are drawn from a multinomial distribution
+    //   and recorded in bulk, and a member of 'Population' is only created,
+    //   with an age and sex drawn from the remaining susceptibles, when they
+    //   are infected. Memory then scales with the attack size rather than
+    //   with 'nPeople'. The individual engine always draws infections as in
+    //   FOIMode::Binomial when lazy. Must be called before Run(). Defaults to
+    //   false.
+    void SetLazyPopulation(bool lazy);
+
+    // Splits the sweep over susceptibles of FOIMode::PerIndividual across
+    //   'nThreads' threads. Susceptibles are swept in fixed chunks, each with
+    //   its own RNG seeded from one draw of 'rng' per FOI update, and the
+    //   infections of the chunks are merged in order, so results for a given
+    //   seed are identical for any 'nThreads' >= 1. They differ from those
+    //   of 'nThreads' = 0, which sweeps serially with 'rng'. Has no effect on
+    //   FOIMode::Binomial or a lazy population. The threads are started
+    //   here and wait between FOI updates. Must be called before Run().
+    //   Defaults to 0.
+    void SetFOIThreads(uint nThreads);
+
+    // Sets the number of partitions of the population used by
+    //   RunMode::Parallel (uint | >= 1), and the number of threads running
+    //   them (uint | >= 1), which are started here. Must be called before
+    //   Run(). Defaults to 1 and 1.
+    void SetPartitions(uint nPartitions, uint nThreads);
+
+    // Makes the length of each step between FOI updates adaptive, in place
+    //   of 'deltaT'. At each update the step is scaled so that the relative
+    //   change in the number of infectives over a step is expected to stay
+    //   near 'tolerance' (double | > 0), growing at most twofold per update
+    //   and bounded by 'minStep' (DayT | > 0) and 'maxStep' (DayT | >=
+    //   minStep) unit: [days]. Steps are short at the peak and long in the
+    //   tails. The force of infection of a step is taken at the infectious
+    //   person-time expected over it (see forceOfInfection), so that steps
+    //   of varying length do not bias the final size. Applies to
+    //   RunMode::Individual, Hybrid and Parallel. Must be called before
+    //   Run().
+    void SetAdaptiveFOIStep(DayT minStep, DayT maxStep, double tolerance);
 
     // Runs the simulation, returning 'true' on success
     bool Run(void);
 
     // Allows access to data generated by the simulation. Supported data structures
-    // are TimeSeries, TimeStatistics, and PyramidTimeSeries.
+    // are TimeSeries, TimeStatistics, and PyramidTimeSeries. Returns nullptr
+    // for data not kept by the RecorderPolicy. Throws before Run() with
+    // FullRecorder.
     template <typename T>
-    T *GetData(SIRData field);
+    T *GetData(SIRData field) {
+        return recorder->template GetData<T>(field);
+    }
+
+    // Returns the recorder holding the data of the simulation, for reading
+    //   its results directly
+    const RecorderPolicy *GetRecorder(void) const {
+        return recorder;
+    }
+
+    // Returns the recorder of the simulation, e.g. to set the sink of a
+    //   StreamingRecorder before Run()
+    RecorderPolicy *GetRecorder(void) {
+        return recorder;
+    }
+
+    // Returns the work done by the engines over the last Run()
+    const RunStats &GetRunStats(void) const {
+        return stats;
+    }
 
 private:
     double lambda;        // Transmission parameter
@@ -88,76 +285,382 @@ private:
     DayT deltaT;         // Timestep
     DayT pLength;    // Period length
 
+    FOIMode foiMode; // Method used to draw infections on each FOI update
+    RunMode runMode; // Engine used by Run()
+    double tauLeapEpsilon; // Bound on relative change per tau-leap
+    PeopleT hybridToAggregate;  // Infectives at which Hybrid starts leaping
+    PeopleT hybridToIndividual; // Infectives at which Hybrid stops leaping
+    bool lazyPopulation; // Whether 'Population' only holds infected people
+    uint foiThreads;     // Threads sweeping susceptibles on FOI updates
+    uint nPartitions;    // Partitions of the population for RunMode::Parallel
+    uint partitionThreads; // Threads running the partitions
+
+    // Threads of the FOI sweep (nullptr when it is serial) and of the
+    //   partitions, started by SetFOIThreads and SetPartitions
+    ThreadPool *foiPool;
+    ThreadPool *partitionPool;
+
+    bool adaptiveFOIStep;   // Whether the step between FOI updates adapts
+    DayT foiMinStep;        // Bounds on an adaptive step
+    DayT foiMaxStep;
+    double foiTolerance;    // Target relative change in infectives per step
+    DayT foiStep;           // Length of the current step between FOI updates
+    PeopleT lastFOIInfected; // Infectives at the last FOI update
+    double infectiveTime;    // Infectious person-time since 'infectiveTimeAt'
+    DayT infectiveTimeAt;    //   up to the last change in infectives
+    double foiExcess;       // Infectious person-time charged for by FOI
+                            //   updates with an adaptive step, less the
+                            //   person-time actually spent infectious
+
     RNG *rng;
 
-    // TimeSeries datastores
-    PrevalenceTimeSeries<int>        *Susceptible;
-    PrevalenceTimeSeries<int>        *Infected;
-    PrevalenceTimeSeries<int>        *Recovered;
-    IncidenceTimeSeries<int>         *Infections;
-    IncidenceTimeSeries<int>         *Recoveries;
-
-    // TimeStatistics datastores
-    ContinuousTimeStatistic     *SusceptibleSx;
-    ContinuousTimeStatistic     *InfectedSx;
-    ContinuousTimeStatistic     *RecoveredSx;
-    DiscreteTimeStatistic       *InfectionsSx;
-    DiscreteTimeStatistic       *RecoveriesSx;
-
-    // PyramidTimeSeries datastores
-    PrevalencePyramidTimeSeries *SusceptiblePyr;
-    PrevalencePyramidTimeSeries *InfectedPyr;
-    PrevalencePyramidTimeSeries *RecoveredPyr;
-    IncidencePyramidTimeSeries  *InfectionsPyr;
-    IncidencePyramidTimeSeries  *RecoveriesPyr;
-
-    // PyramidData datastores
-    PyramidData<int> *TotalAgeCounts; 
-    PyramidData<int> *InfectionsAgeCounts;
-    PyramidData<double> *InfectionsAgePercent;
+    // Datastores of the simulation
+    RecorderPolicy *recorder;
+
+    // Work done over the current run
+    RunStats stats;
+
+    // Current number of infectives
+    PeopleT nInfected;
 
     // Age distribution and sex distribution
     StatisticalDistributions::UniformDiscrete   *ageDist;
     StatisticalDistributions::Bernoulli         *sexDist;
     StatisticalDistributions::Exponential       *timeToRecoveryDist;
+    StatisticalDistributions::Uniform           *unitDist;
 
-    // Vector of Individuals who comprise the population
-    vector<Individual> Population;
+    // Individuals who comprise the population
+    PopulationStore Population;
 
-    // Pointer to the EventQueue holding scheduled events
-    EQ *eq;
+    // Compact index of the members of 'Population' who are still
+    //   susceptible. Individuals are swap-removed on infection, so the
+    //   FOIUpdateEvent only visits susceptibles.
+    vector<PeopleT> SusceptibleIdx;
+
+    // Position of each individual within 'SusceptibleIdx'
+    vector<PeopleT> SusceptiblePos;
 
-    // Increments the relevant TimeSeries and PyramidTimeSeries by 'increment'
-    //   for an individual of properties specified by 'idv' at time 't'. Returns
-    //   true on successful increment, false otherwise.
-    bool IdvIncrement(DayT t, SIRData dtype, Individual idv, int increment);
+    // Number of susceptibles whose times to infection are drawn together
+    //   by the FOIUpdateEvent
+    static constexpr PeopleT FOIBlockSize = 256;
 
-    // ––- Event Generators: InfectionEvent, RecoveryEvent, and FOIEvent -––
+    // Number of susceptibles in each chunk of a threaded FOI sweep (see
+    //   SetFOIThreads). Fixed, so that results do not depend on the number
+    //   of threads.
+    static constexpr PeopleT FOIChunkSize = 1 << 16;
 
-    // Creates an event for an infection of individual 'individualIdx'
-    // On execution of event, recovery of individual is scheduled according to
-    //   function 'timeToRecovery' with input parameter 't' set to time of
-    //   infection.
-    EventFunc InfectionEvent(int individualIdx);
+    // Infections drawn from each chunk of a threaded FOI sweep
+    vector<vector<SIREvent>> chunkInfections;
 
-    // Creates an event for the recovery of individual 'individualIdx'.
-    EventFunc RecoveryEvent(int individualIdx);
+    // Counts of susceptibles and infectives by age and sex, used by the
+    //   aggregate engines in place of 'Population'. With a lazy population,
+    //   'SusceptibleCounts' also holds the susceptibles not yet materialized
+    //   in 'Population' by the individual engine.
+    AgeSexCounts SusceptibleCounts;
+    AgeSexCounts InfectedCounts;
 
-    // Creates an event for a Force-Of-Infection event.
-    // An FOIEvent calculates the time-to-infection of each Individual in the
-    //   population. If the time-to-infection is less than dt, the infection
-    //   of the individual is scheduled on the EventQueue. Additionally,
-    //   the FOIEvent schedules the next FOIEvent for time 't + dt'.
-    EventFunc FOIUpdateEvent(void);
+    // A tau-leap is only taken if it is expected to cover at least
+    //   'TauLeapMinEvents' events; otherwise 'TauLeapExactSteps' exact
+    //   Gillespie steps are taken instead
+    static constexpr double TauLeapMinEvents  = 10;
+    static constexpr int    TauLeapExactSteps = 100;
+
+    // Pointer to the queue holding scheduled events
+    EQ *eq;
 
-    // Calculates time to infection at time 't'
-    DayT timeToInfection(DayT t);
+    // Pointer to the store of scheduled recoveries. Every infective has
+    //   one, so they are kept out of 'eq' and merged with it as the
+    //   simulation runs.
+    RecoveryStore *recoveries;
+
+    // Time of the FOIUpdateEvent on the queue, which ends the current batch
+    //   of events (see AdvanceIndividual)
+    DayT nextFOIUpdate;
+
+    // Infections drawn by the current FOIUpdateEvent, scheduled together
+    //   once it has drawn them all
+    vector<SIREvent> newInfections;
+
+    // An infection or recovery run by a partition of RunMode::Parallel, to
+    //   be recorded at the next FOI update
+    struct Transition {
+        DayT     t;
+        uint32_t idx;
+        bool     recovery;
+    };
+
+    // A partition of the population for RunMode::Parallel, owning the
+    //   people ['begin', 'end') and their events
+    struct Partition {
+        PeopleT begin;
+        PeopleT end;
+
+        // Index of the susceptibles of the partition, and the position of
+        //   person 'begin + k' within it
+        vector<PeopleT> susceptibleIdx;
+        vector<PeopleT> susceptiblePos;
+
+        unique_ptr<EQ>            eq;
+        unique_ptr<RecoveryStore> recoveries;
+        unique_ptr<RNG>           rng;
+
+        // Infections drawn by the last FOI update, and the susceptibles
+        //   drawn for by every FOI update (see RunStats)
+        vector<SIREvent> newInfections;
+        uint64_t         foiDraws;
+
+        // Transitions run since the last FOI update, in order of time
+        vector<Transition> transitions;
+    };
+
+    // Increments the relevant TimeSeries and PyramidTimeSeries of field 'D'
+    //   by 'increment' for an individual of properties specified by 'idv' at
+    //   time 't'. Returns true on successful increment, false otherwise.
+    template <SIRData D>
+    bool IdvIncrement(DayT t, Individual idv, int increment);
+
+    // Removes individual 'individualIdx' from 'SusceptibleIdx' by swapping
+    //   the last entry of the index into its place
+    void RemoveSusceptible(PeopleT individualIdx);
+
+    // Exchanges the entries at positions 'i' and 'j' of 'SusceptibleIdx'
+    void SwapSusceptibles(PeopleT i, PeopleT j);
+
+    // As RemoveSusceptible and SwapSusceptibles, for an index of
+    //   susceptibles 'idx' whose positions are kept in 'pos' by person, from
+    //   person 'base' on. Shared by the serial engine ('base' 0) and the
+    //   partitions of RunMode::Parallel.
+    static void RemoveFromIndex(vector<PeopleT> &idx, vector<PeopleT> &pos,
+                                PeopleT base, PeopleT individualIdx);
+    static void SwapInIndex(vector<PeopleT> &idx, vector<PeopleT> &pos,
+                            PeopleT base, PeopleT i, PeopleT j);
+
+    // ––- Events: InfectionEvent, RecoveryEvent, and FOIUpdateEvent -––
+
+    // Schedules an event of kind 'kind' for individual 'individualIdx' at
+    //   time 't'
+    void Schedule(DayT t, SIREvent::Kind kind, PeopleT individualIdx);
+
+    // Schedules the recovery of individual 'individualIdx' at time 't' in
+    //   'recoveries'
+    void ScheduleRecovery(DayT t, PeopleT individualIdx);
+
+    // Runs event 'e' by dispatching on its kind
+    void RunEvent(const SIREvent &e);
+
+    // Runs the infection of individual 'individualIdx' at time 't'.
+    //   Recovery of the individual is scheduled according to function
+    //   'timeToRecovery' with input parameter 't' set to time of infection.
+    void InfectionEvent(DayT t, PeopleT individualIdx);
+
+    // Runs the recovery of individual 'individualIdx' at time 't'
+    void RecoveryEvent(DayT t, PeopleT individualIdx);
+
+    // Runs a Force-Of-Infection update at time 't'.
+    // An FOIUpdateEvent decides which susceptibles are infected during
+    //   [t, t + dt) and schedules their infections on the event queue in bulk.
+    //   Additionally, it schedules the next FOIUpdateEvent for time 't + dt'.
+    void FOIUpdateEvent(DayT t);
+
+    // Draws the infections of the step beginning at 't' into 'newInfections'
+    //   by drawing a time-to-infection for each susceptible
+    //   (FOIMode::PerIndividual)
+    void DrawInfectionsPerIndividual(DayT t);
+
+    // Draws the infections of the step beginning at 't' into 'newInfections'
+    //   as DrawInfectionsPerIndividual does, sweeping chunks of
+    //   'FOIChunkSize' susceptibles on 'foiThreads' threads
+    void DrawInfectionsChunked(DayT t);
+
+    // Returns the seed of the RNG of chunk 'chunk' of a threaded FOI sweep
+    //   seeded by 'seed'
+    static uint64_t ChunkSeed(uint64_t seed, PeopleT chunk);
+
+    // Appends to 'infections' the infections during the step beginning at
+    //   't' of the 'n' susceptibles listed in 'idx', under force of infection
+    //   'foi', drawing with 'unit' from 'r'
+    void SweepSusceptibles(DayT t, double foi, const PeopleT *idx, PeopleT n,
+                           RNG &r, StatisticalDistributions::Uniform &unit,
+                           vector<SIREvent> &infections);
+
+    // Draws the infections of the step beginning at 't' into 'newInfections'
+    //   by binomial thinning of the susceptibles (FOIMode::Binomial)
+    void DrawInfectionsBinomial(DayT t);
+
+    // Appends to 'infections' the infections during the step beginning at
+    //   't' of the susceptibles in the index 'idx', 'pos' and 'base' (see
+    //   RemoveFromIndex) under force of infection 'foi', by binomial
+    //   thinning, drawing with 'unit' from 'r'. The index is reordered so
+    //   that the people infected come first.
+    void ThinSusceptibles(DayT t, double foi, vector<PeopleT> &idx,
+                          vector<PeopleT> &pos, PeopleT base, RNG &r,
+                          StatisticalDistributions::Uniform &unit,
+                          vector<SIREvent> &infections);
+
+    // Draws the infections of the step beginning at 't' into 'newInfections'
+    //   by binomial thinning of the susceptibles not yet materialized,
+    //   materializing each person infected (lazy population)
+    void DrawInfectionsLazy(DayT t);
+
+    // Draws a susceptible from 'SusceptibleCounts' and appends them to
+    //   'Population', returning their index
+    PeopleT MaterializeSusceptible(void);
+
+    // Chooses the length of the step beginning at the FOI update at time
+    //   't', storing it in 'foiStep', and returns it. Always 'deltaT' unless
+    //   SetAdaptiveFOIStep was called.
+    DayT NextFOIStep(DayT t);
+
+    // Calculates the force of infection at time 't' from FOIPolicy.
+    //   Constant within a step, so it is computed once per FOIUpdateEvent.
+    //   With an adaptive step, it is taken at the infectious person-time
+    //   expected over the step, corrected by that run since the last update
+    //   (see 'foiExcess').
+    double forceOfInfection(DayT t);
+
+    // Restarts the count of infectious person-time at time 't'
+    void ResetFOIAccount(DayT t);
+
+    // Fills 'ttIs' with 'n' independent times to infection under force of
+    //   infection 'foi'. The uniforms are drawn by 'unit' from 'r' and
+    //   transformed by the vectorized kernel in ExpKernel.h.
+    void timesToInfection(double foi, DayT *ttIs, PeopleT n,
+                          RNG &r, StatisticalDistributions::Uniform &unit);
 
     // Calculates time to recovery for infection occurring at time 't'
     DayT timeToRecovery(DayT t);
 
-    // Calculates the percent of each age group that was infected
-    void CalculateInfectionAgePercent(void);
+    // Runs the individual-level engine (RunMode::Individual)
+    void RunIndividual(void);
+
+    // Runs the hybrid engine (RunMode::Hybrid)
+    void RunHybrid(void);
+
+    // Runs the partitioned individual engine (RunMode::Parallel)
+    void RunParallel(void);
+
+    // Schedules in partition 'p' the infections of its susceptibles during
+    //   the step beginning at 't', under force of infection 'foi'
+    void PartitionFOIUpdate(Partition &p, DayT t, double foi);
+
+    // Runs the infections and recoveries of partition 'p' before 'tEnd',
+    //   logging them in its 'transitions'
+    void PartitionAdvance(Partition &p, DayT tEnd);
+
+    // Records the transitions logged by every partition in order of time,
+    //   breaking ties by partition, up to the recovery of the last infective
+    //   if there is one, and clears the logs
+    void RecordTransitions(vector<Partition> &partitions);
+
+    // Creates the 'nPeople' susceptible members of 'Population' and records
+    //   them
+    void InitPopulation(void);
+
+    // Returns the time of the earliest event or recovery, or infinity if
+    //   there is none
+    DayT NextTime(void);
+
+    // Runs the earliest event or recovery, setting 't' to its time. There
+    //   must be one.
+    void RunNext(DayT &t);
+
+    // Runs events from the event queue, and recoveries from the store of
+    //   recoveries, in order of time until both are empty, 'tMax' is reached,
+    //   there are no infectives left, or the number of infectives reaches
+    //   'stopAt'. Entries run in batches, each ending at the next
+    //   FOIUpdateEvent, and 'tMax' and 'stopAt' are only checked between
+    //   batches. Sets 't' to the time of the last event run. Returns true only
+    //   if stopped because of 'stopAt'.
+    bool AdvanceIndividual(DayT &t, PeopleT stopAt);
+
+    // Advances the aggregate counts from time 't' by tau-leaping until
+    //   'tMax' is reached, there are no infectives left, or the number of
+    //   infectives falls to 'stopAt' or below. Returns true only if stopped
+    //   because of 'stopAt'.
+    bool AdvanceTauLeaping(DayT &t, PeopleT stopAt);
+
+    // Hands the state of 'Population' over to the aggregate counts,
+    //   discarding all scheduled events
+    void PopulationToCounts(void);
+
+    // Rebuilds the health states of 'Population' at time 't' from the
+    //   aggregate counts, scheduling a recovery for every infective and the
+    //   next FOIUpdateEvent
+    void CountsToPopulation(DayT t);
+
+    // Runs the aggregate engine using Gillespie's direct method
+    //   (RunMode::Gillespie)
+    void RunGillespie(void);
+
+    // Runs the aggregate engine using adaptive tau-leaping
+    //   (RunMode::TauLeaping)
+    void RunTauLeaping(void);
+
+    // Advances the aggregate counts from time 't' by one exact event, chosen
+    //   by Gillespie's direct method, and moves 't' to the time of the event.
+    //   Returns false, leaving the counts unchanged, if there are no
+    //   infectives or the event would fall at or after 'tMax'.
+    bool GillespieStep(DayT &t);
+
+    // Returns the largest leap for which the expected relative change in S
+    //   and I, and the expected infections and recoveries relative to I, stay
+    //   within 'tauLeapEpsilon', capped at deltaT
+    DayT TauLeapSize(void);
+
+    // Draws and applies the infections and recoveries in each cell during a
+    //   leap of length 'tau' starting at time 't'
+    void TauLeap(DayT t, DayT tau);
+
+    // Draws the initial population into 'SusceptibleCounts' and records it.
+    //   With a lazy population, the counts of each cell are drawn at once
+    //   from a multinomial distribution.
+    void InitCounts(void);
+
+    // Returns an Individual carrying the age and sex of cell 'cell' of the
+    //   aggregate counts, for recording
+    Individual CellIndividual(AgeSexCounts::CellT cell, HealthState hs);
+
+    // Infects a susceptible drawn uniformly from 'SusceptibleCounts' at time
+    //   't', updating the counts and the datastores
+    void AggregateInfection(DayT t);
+
+    // Infects 'n' susceptibles of cell 'c' of the aggregate counts at time
+    //   't', updating the counts and the datastores
+    void InfectCell(DayT t, AgeSexCounts::CellT c, long n);
+
+    // Closes the count of infectious person-time at time 't', on handing
+    //   over to the aggregate counts. With an adaptive step, the
+    //   susceptibles are exposed at once to any person-time not yet charged
+    //   for by an FOI update (see forceOfInfection), which would otherwise be
+    //   lost.
+    void SettleFOIAccount(DayT t);
+
+    // Recovers an infective drawn uniformly from 'InfectedCounts' at time
+    //   't', updating the counts and the datastores
+    void AggregateRecovery(DayT t);
 };
 
+// Simulation recording every datastore
+using SIRSimulation =
+  BasicSIRSimulation<FullRecorder, FrequencyDependentFOI, CalendarEventQueue>;
+
+// Lean simulation for calibration, recording only Infections
+using CalibrationSIRSimulation =
+  BasicSIRSimulation<InfectionsRecorder, FrequencyDependentFOI, CalendarEventQueue>;
+
+// Simulation recording every datastore, with event times rounded to integer
+//   ticks by a radix heap
+using RadixSIRSimulation =
+  BasicSIRSimulation<FullRecorder, FrequencyDependentFOI, RadixEventQueue>;
+
+// Simulation passing each period to a PeriodSink as it closes, keeping only
+//   a few periods in memory
+using StreamingSIRSimulation =
+  BasicSIRSimulation<StreamingRecorder, FrequencyDependentFOI, CalendarEventQueue>;
+
+extern template class BasicSIRSimulation<FullRecorder, FrequencyDependentFOI, CalendarEventQueue>;
+extern template class BasicSIRSimulation<InfectionsRecorder, FrequencyDependentFOI, CalendarEventQueue>;
+extern template class BasicSIRSimulation<FullRecorder, FrequencyDependentFOI, RadixEventQueue>;
+extern template class BasicSIRSimulation<StreamingRecorder, FrequencyDependentFOI, CalendarEventQueue>;
+
 }
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace SIRlib {
+
+// A fixed set of worker threads that run loops handed to them by
+//   ParallelFor. The threads are started once, when the pool is created,
+//   and wait between loops, so a simulation can run a loop at every FOI
+//   update without starting a thread each time.
+class ThreadPool {
+public:
+    // Creates a pool running loops on 'nThreads' (>= 1) threads: the thread
+    //   calling ParallelFor and 'nThreads' - 1 workers
+    explicit ThreadPool(unsigned int nThreads);
+
+    // Stops and joins the workers
+    ~ThreadPool(void);
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    unsigned int NumThreads(void) const { return (unsigned int)workers.size() + 1; }
+
+    // Calls 'f(i)' for every 'i' in [0, n) on up to NumThreads() threads.
+    //   Thread 'w' takes i = w, w + nActive, ..., and thread 0 is the
+    //   calling thread. Returns once every call has returned (barrier),
+    //   rethrowing the first exception thrown by a call, if any. Not
+    //   reentrant.
+    template <typename F>
+    void ParallelFor(unsigned int n, F f) {
+        Run(n, std::function<void(unsigned int)>(f));
+    }
+
+private:
+    using Loop = std::function<void(unsigned int)>;
+
+    void Run(unsigned int n, const Loop &f);
+
+    // Body of worker thread 'w' (>= 1)
+    void Work(unsigned int w);
+
+    // Calls 'f(i)' for the 'i' of thread 'w' in a loop of 'n' on 'nActive'
+    //   threads, keeping the first exception thrown
+    void RunShare(const Loop &f, unsigned int n, unsigned int nActive, unsigned int w);
+
+    std::vector<std::thread> workers;
+
+    std::mutex              mutex;
+    std::condition_variable started;  // A loop was handed out, or stopping
+    std::condition_variable finished; // The last worker of a loop returned
+
+    // The current loop, guarded by 'mutex'. 'generation' counts the loops
+    //   handed out, and 'pending' the workers yet to finish the current one.
+    const Loop   *loop;
+    unsigned int  loopN;
+    unsigned int  loopActive;
+    unsigned long generation;
+    unsigned int  pending;
+    bool          stopping;
+
+    std::exception_ptr error;
+};
+
+}
@@ -0,0 +1,56 @@
+#include "../include/SIRlib/AgeSexCounts.h"
+
+using namespace std;
+using namespace SIRlib;
+
+using CellT  = AgeSexCounts::CellT;
+using CountT = AgeSexCounts::CountT;
+
+AgeSexCounts::AgeSexCounts(unsigned int _ageMin, unsigned int _ageMax)
+{
+    ageMin = _ageMin;
+    nAges  = _ageMax - _ageMin + 1;
+
+    counts.assign(2 * nAges, 0);
+    tree.assign(2 * nAges + 1, 0);
+    total = 0;
+
+    // Highest power of two <= number of cells, for descending the tree
+    topBit = 1;
+    while (topBit * 2 <= counts.size())
+        topBit *= 2;
+}
+
+void AgeSexCounts::Add(CellT cell, CountT n)
+{
+    counts[cell] += n;
+    total        += n;
+
+    for (CellT i = cell + 1; i < tree.size(); i += i & (~i + 1))
+        tree[i] += n;
+}
+
+CellT AgeSexCounts::Sample(double u) const
+{
+    CountT target = (CountT)(u * total);
+    if (target >= total)
+        target = total - 1;
+
+    // Find the last position whose prefix sum is <= target; the cell after it
+    //   holds the target'th person
+    CellT pos = 0;
+    for (CellT bit = topBit; bit > 0; bit /= 2)
+        if (pos + bit < tree.size() && tree[pos + bit] <= target) {
+            pos    += bit;
+            target -= tree[pos];
+        }
+
+    return pos;
+}
+
+void AgeSexCounts::Clear(void)
+{
+    counts.assign(counts.size(), 0);
+    tree.assign(tree.size(), 0);
+    total = 0;
+}
@@ -0,0 +1,197 @@
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define SIRLIB_X86_64_SIMD
+#include <immintrin.h>
+#endif
+
+#include "../include/SIRlib/ExpKernel.h"
+
+using namespace std;
+using namespace SIRlib;
+
+// The vector kernels compute log(u) as in fdlibm: u = 2^e * m with m in
+//   [sqrt(2)/2, sqrt(2)), f = m - 1, s = f/(2+f), and
+//
+//   log(u) = e*ln2 + f - f^2/2 + s*(f^2/2 + R(s^2))
+//
+//   where R is a minimax polynomial. Inputs must be normal, positive doubles,
+//   which holds for uniforms on (0, 1].
+
+#ifdef SIRLIB_X86_64_SIMD
+
+static const double Lg1   = 6.666666666666735130e-01;
+static const double Lg2   = 3.999999999940941908e-01;
+static const double Lg3   = 2.857142874366239149e-01;
+static const double Lg4   = 2.222219843214978396e-01;
+static const double Lg5   = 1.818357216161805012e-01;
+static const double Lg6   = 1.531383769920937332e-01;
+static const double Lg7   = 1.479819860511658591e-01;
+static const double Ln2Hi = 6.93147180369123816490e-01;
+static const double Ln2Lo = 1.90821492927058770002e-10;
+static const double Sqrt2 = 1.41421356237309504880;
+
+// 2^52 + 1023: subtracting this from the double whose bit pattern is
+//   (0x433 << 52) | biasedExponent yields the unbiased exponent
+static const double ExpMagic = 4503599627370496.0 + 1023.0;
+
+static const long long MantissaMask = 0x000FFFFFFFFFFFFFLL;
+static const long long OneBits      = 0x3FF0000000000000LL;
+static const long long MagicBits    = 0x4330000000000000LL;
+
+static inline __m128d logSSE2(__m128d x)
+{
+    __m128i bits = _mm_castpd_si128(x);
+
+    // Split x into exponent e and mantissa m in [1, 2)
+    __m128i biased = _mm_srli_epi64(bits, 52);
+    __m128d e = _mm_sub_pd(_mm_castsi128_pd(_mm_or_si128(biased, _mm_set1_epi64x(MagicBits))),
+                           _mm_set1_pd(ExpMagic));
+    __m128d m = _mm_castsi128_pd(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi64x(MantissaMask)),
+                                              _mm_set1_epi64x(OneBits)));
+
+    // Bring m into [sqrt(2)/2, sqrt(2))
+    __m128d big = _mm_cmpgt_pd(m, _mm_set1_pd(Sqrt2));
+    m = _mm_or_pd(_mm_and_pd(big, _mm_mul_pd(m, _mm_set1_pd(0.5))), _mm_andnot_pd(big, m));
+    e = _mm_add_pd(e, _mm_and_pd(big, _mm_set1_pd(1.0)));
+
+    __m128d f    = _mm_sub_pd(m, _mm_set1_pd(1.0));
+    __m128d hfsq = _mm_mul_pd(_mm_set1_pd(0.5), _mm_mul_pd(f, f));
+    __m128d s    = _mm_div_pd(f, _mm_add_pd(_mm_set1_pd(2.0), f));
+    __m128d z    = _mm_mul_pd(s, s);
+
+    __m128d R = _mm_set1_pd(Lg7);
+    R = _mm_add_pd(_mm_mul_pd(R, z), _mm_set1_pd(Lg6));
+    R = _mm_add_pd(_mm_mul_pd(R, z), _mm_set1_pd(Lg5));
+    R = _mm_add_pd(_mm_mul_pd(R, z), _mm_set1_pd(Lg4));
+    R = _mm_add_pd(_mm_mul_pd(R, z), _mm_set1_pd(Lg3));
+    R = _mm_add_pd(_mm_mul_pd(R, z), _mm_set1_pd(Lg2));
+    R = _mm_add_pd(_mm_mul_pd(R, z), _mm_set1_pd(Lg1));
+    R = _mm_mul_pd(R, z);
+
+    // e*ln2_hi - ((hfsq - (s*(hfsq + R) + e*ln2_lo)) - f)
+    __m128d t = _mm_add_pd(_mm_mul_pd(s, _mm_add_pd(hfsq, R)),
+                           _mm_mul_pd(e, _mm_set1_pd(Ln2Lo)));
+    return _mm_sub_pd(_mm_mul_pd(e, _mm_set1_pd(Ln2Hi)),
+                      _mm_sub_pd(_mm_sub_pd(hfsq, t), f));
+}
+
+__attribute__((target("avx2")))
+static inline __m256d logAVX2(__m256d x)
+{
+    __m256i bits = _mm256_castpd_si256(x);
+
+    // Split x into exponent e and mantissa m in [1, 2)
+    __m256i biased = _mm256_srli_epi64(bits, 52);
+    __m256d e = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(biased, _mm256_set1_epi64x(MagicBits))),
+                              _mm256_set1_pd(ExpMagic));
+    __m256d m = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi64x(MantissaMask)),
+                                                    _mm256_set1_epi64x(OneBits)));
+
+    // Bring m into [sqrt(2)/2, sqrt(2))
+    __m256d big = _mm256_cmp_pd(m, _mm256_set1_pd(Sqrt2), _CMP_GT_OQ);
+    m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), big);
+    e = _mm256_add_pd(e, _mm256_and_pd(big, _mm256_set1_pd(1.0)));
+
+    __m256d f    = _mm256_sub_pd(m, _mm256_set1_pd(1.0));
+    __m256d hfsq = _mm256_mul_pd(_mm256_set1_pd(0.5), _mm256_mul_pd(f, f));
+    __m256d s    = _mm256_div_pd(f, _mm256_add_pd(_mm256_set1_pd(2.0), f));
+    __m256d z    = _mm256_mul_pd(s, s);
+
+    __m256d R = _mm256_set1_pd(Lg7);
+    R = _mm256_add_pd(_mm256_mul_pd(R, z), _mm256_set1_pd(Lg6));
+    R = _mm256_add_pd(_mm256_mul_pd(R, z), _mm256_set1_pd(Lg5));
+    R = _mm256_add_pd(_mm256_mul_pd(R, z), _mm256_set1_pd(Lg4));
+    R = _mm256_add_pd(_mm256_mul_pd(R, z), _mm256_set1_pd(Lg3));
+    R = _mm256_add_pd(_mm256_mul_pd(R, z), _mm256_set1_pd(Lg2));
+    R = _mm256_add_pd(_mm256_mul_pd(R, z), _mm256_set1_pd(Lg1));
+    R = _mm256_mul_pd(R, z);
+
+    // e*ln2_hi - ((hfsq - (s*(hfsq + R) + e*ln2_lo)) - f)
+    __m256d t = _mm256_add_pd(_mm256_mul_pd(s, _mm256_add_pd(hfsq, R)),
+                              _mm256_mul_pd(e, _mm256_set1_pd(Ln2Lo)));
+    return _mm256_sub_pd(_mm256_mul_pd(e, _mm256_set1_pd(Ln2Hi)),
+                         _mm256_sub_pd(_mm256_sub_pd(hfsq, t), f));
+}
+
+#endif
+
+static void expScalar(const double *u, double *out, size_t n, double rate)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = -log(u[i]) / rate;
+}
+
+#ifdef SIRLIB_X86_64_SIMD
+
+static void expSSE2(const double *u, double *out, size_t n, double rate)
+{
+    __m128d scale = _mm_set1_pd(-1 / rate);
+    size_t i = 0;
+
+    for (; i + 2 <= n; i += 2)
+        _mm_storeu_pd(out + i, _mm_mul_pd(logSSE2(_mm_loadu_pd(u + i)), scale));
+
+    expScalar(u + i, out + i, n - i, rate);
+}
+
+__attribute__((target("avx2")))
+static void expAVX2(const double *u, double *out, size_t n, double rate)
+{
+    __m256d scale = _mm256_set1_pd(-1 / rate);
+    size_t i = 0;
+
+    // Two independent vectors per iteration to hide the latency of the
+    //   division in the log kernel
+    for (; i + 8 <= n; i += 8) {
+        __m256d a = logAVX2(_mm256_loadu_pd(u + i));
+        __m256d b = logAVX2(_mm256_loadu_pd(u + i + 4));
+        _mm256_storeu_pd(out + i,     _mm256_mul_pd(a, scale));
+        _mm256_storeu_pd(out + i + 4, _mm256_mul_pd(b, scale));
+    }
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(logAVX2(_mm256_loadu_pd(u + i)), scale));
+
+    expScalar(u + i, out + i, n - i, rate);
+}
+
+#endif
+
+SIMDLevel SIRlib::DetectSIMDLevel(void)
+{
+#ifdef SIRLIB_X86_64_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return SIMDLevel::AVX2;
+
+    // SSE2 is part of the x86-64 baseline
+    return SIMDLevel::SSE2;
+#else
+    return SIMDLevel::Scalar;
+#endif
+}
+
+void SIRlib::ExponentialFromUniforms(SIMDLevel level, const double *u, \
+                                     double *out, size_t n, double rate)
+{
+    static const SIMDLevel supported = DetectSIMDLevel();
+
+    if (level > supported)
+        throw out_of_range("SIMD level not supported by this CPU");
+
+    switch (level) {
+#ifdef SIRLIB_X86_64_SIMD
+        case SIMDLevel::AVX2: expAVX2(u, out, n, rate);   break;
+        case SIMDLevel::SSE2: expSSE2(u, out, n, rate);   break;
+#endif
+        default:              expScalar(u, out, n, rate); break;
+    }
+}
+
+void SIRlib::ExponentialFromUniforms(const double *u, double *out, size_t n, double rate)
+{
+    static const SIMDLevel level = DetectSIMDLevel();
+
+    ExponentialFromUniforms(level, u, out, n, rate);
+}
@@ -0,0 +1,396 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "../include/SIRlib/Recorders.h"
+
+using namespace std;
+using namespace SimulationLib;
+using namespace SIRlib;
+
+// Aliases for specialized data structures
+using CTSx = ContinuousTimeStatistic;
+using DTSx = DiscreteTimeStatistic;
+using PTS  = PrevalenceTimeSeries<int>;
+using PPTS = PrevalencePyramidTimeSeries;
+using ITS  = IncidenceTimeSeries<int>;
+using IPTS = IncidencePyramidTimeSeries;
+
+// Aliases for unspecialized data structures
+using TS   = TimeSeries<int>;
+using TSx  = TimeStatistic;
+using PyTS = PyramidTimeSeries;
+
+// Returns the age group of every age in [0, maxAge] for the age breaks
+//   'breaks'. An age equal to a break starts the next group.
+static vector<uint8_t> AgeGroupTable(const vector<double> &breaks, Age maxAge)
+{
+    vector<uint8_t> table(maxAge + 1);
+
+    for (Age age = 0; age <= maxAge; age++)
+        table[age] = (uint8_t)(upper_bound(breaks.begin(), breaks.end(), (double)age)
+                               - breaks.begin());
+
+    return table;
+}
+
+FullRecorder::FullRecorder(uint tMax, uint pLength, vector<double> ageBreaks,
+                           SIRDataMask outputs)
+  : tMax(tMax), pLength(pLength), outputs(outputs), closed(false), ageBreaks(ageBreaks)
+{
+    nPeriods = tMax / pLength + 1;
+    nDays    = nPeriods * pLength;
+
+    // Create the age group tables
+    profileAgeBreaks.assign(begin(ProfileAgeBreaks), end(ProfileAgeBreaks));
+    nAgeGroups       = (int)ageBreaks.size() + 1;
+    nProfileGroups   = (int)profileAgeBreaks.size() + 1;
+    ageGroup         = AgeGroupTable(ageBreaks, MaxAge);
+    profileAgeGroup  = AgeGroupTable(profileAgeBreaks, MaxAge);
+
+    // Give each kept field a column of the block
+    nColumns = 0;
+    for (int field = 0; field < nFields; field++)
+        column[field] = (outputs & SIRDataBit((SIRData)field)) ? nColumns++ : -1;
+
+    // Allocate the result block and find its parts
+    size_t nTotals     = (size_t)nPeriods * nColumns;
+    size_t nByAgeGroup = nTotals * nSexes * nAgeGroups;
+    size_t nDaily      = (size_t)nDays * nColumns;
+
+    block.assign(nTotals + nByAgeGroup + 2 * nProfileGroups + nDaily, 0);
+    totals            = block.data();
+    byAgeGroup        = totals + nTotals;
+    infectionsProfile = byAgeGroup + nByAgeGroup;
+    populationProfile = infectionsProfile + nProfileGroups;
+    dailyTotals       = populationProfile + nProfileGroups;
+
+    for (int field = 0; field < nFields; field++) {
+        series[field]     = nullptr;
+        statistics[field] = nullptr;
+        pyramids[field]   = nullptr;
+    }
+    InfectionsAgePercent = nullptr;
+}
+
+// Returns the percent of the infections in 'profile' in each of the age
+//   groups of 'breaks'
+static PyramidData<double> *AgePercent(const int *profile, const vector<double> &breaks)
+{
+    PyramidData<double> *percent = new PyramidData<double>(1, breaks);
+    int nGroups     = (int)breaks.size() + 1;
+    int nInfections = 0;
+
+    for (int i = 0; i < nGroups; i++)
+        nInfections += profile[i];
+
+    for (int i = 0; i < nGroups; i++)
+        percent->UpdateByIdx(0, i, (double)profile[i] / (double)nInfections);
+
+    return percent;
+}
+
+// Returns true for the fields counted by prevalence rather than incidence
+static bool IsPrevalence(SIRData field)
+{
+    return field == SIRData::Susceptible
+        || field == SIRData::Infected
+        || field == SIRData::Recovered;
+}
+
+FullRecorder::~FullRecorder(void)
+{
+    // Delete through the types the datastores were created with
+    for (int field = 0; field < nFields; field++) {
+        if (IsPrevalence((SIRData)field)) {
+            delete static_cast<PTS *>(series[field]);
+            delete static_cast<CTSx *>(statistics[field]);
+            delete static_cast<PPTS *>(pyramids[field]);
+        } else {
+            delete static_cast<ITS *>(series[field]);
+            delete static_cast<DTSx *>(statistics[field]);
+            delete static_cast<IPTS *>(pyramids[field]);
+        }
+    }
+    delete InfectionsAgePercent;
+}
+
+void FullRecorder::BuildField(SIRData field)
+{
+    int f = (int)field;
+
+    if (!closed)
+        throw out_of_range("GetData before Close()");
+    if (series[f] || !(outputs & SIRDataBit(field)))
+        return;
+
+    const char *names[nFields] = {
+        "Susceptible", "Infected", "Recovered", "Infections", "Recoveries"
+    };
+
+    // Create the statistic, time series and pyramid of the field
+    if (IsPrevalence(field)) {
+        statistics[f] = new CTSx(names[f]);
+        series[f]     = new PTS(names[f],    tMax, pLength, 1, statistics[f]);
+        pyramids[f]   = new PPTS(names[f], 0, tMax, pLength, 2, ageBreaks);
+    } else {
+        statistics[f] = new DTSx(names[f]);
+        series[f]     = new ITS(names[f], 0, tMax, pLength, 1, statistics[f]);
+        pyramids[f]   = new IPTS(names[f], 0, tMax, pLength, 2, ageBreaks);
+    }
+
+    // Replay the changes of each day into the time series, and those of
+    //   each period, at its start, into the pyramid
+    for (uint day = 0; day < nDays; day++) {
+        int n = dailyTotals[day * nColumns + column[f]];
+        if (n != 0)
+            series[f]->Record(day, n);
+    }
+
+    for (uint period = 0; period < nPeriods; period++) {
+        int t = (int)(period * pLength);
+
+        for (int sex = 0; sex < nSexes; sex++)
+            for (int group = 0; group < nAgeGroups; group++) {
+                int n = ByAgeGroup(field, period, sex, group);
+                if (n != 0)
+                    pyramids[f]->UpdateByIdx(t, sex, group, n);
+            }
+    }
+
+    series[f]->Close();
+    pyramids[f]->Close();
+}
+
+void FullRecorder::CalculateInfectionAgePercent(void) {
+    if (!closed)
+        throw out_of_range("GetData before Close()");
+    if (InfectionsAgePercent || !(outputs & SIRDataBit(SIRData::Infections)))
+        return;
+
+    InfectionsAgePercent = AgePercent(infectionsProfile, profileAgeBreaks);
+}
+
+void FullRecorder::Close(void)
+{
+    // Sum the totals of each period over sex and age group
+    for (uint period = 0; period < nPeriods; period++)
+        for (int c = 0; c < nColumns; c++) {
+            int total = 0;
+            int *cells = byAgeGroup + (period * nColumns + c) * nSexes * nAgeGroups;
+
+            for (int cell = 0; cell < nSexes * nAgeGroups; cell++)
+                total += cells[cell];
+
+            totals[period * nColumns + c] = total;
+        }
+
+    closed = true;
+}
+
+// Specialization for TimeSeries
+template <>
+TS *FullRecorder::GetData<TS>(SIRData field)
+{
+    BuildField(field);
+    return series[(int)field];
+}
+
+template <>
+PrevalenceTimeSeries<int> *FullRecorder::GetData<PrevalenceTimeSeries<int>>(SIRData field)
+{
+    switch(field) {
+        case SIRData::Susceptible:
+        case SIRData::Infected:
+        case SIRData::Recovered:
+            BuildField(field);
+            return static_cast<PTS *>(series[(int)field]);
+        default:                   return nullptr;
+    }
+}
+
+template <>
+IncidenceTimeSeries<int> *FullRecorder::GetData<IncidenceTimeSeries<int>>(SIRData field)
+{
+    switch(field) {
+        case SIRData::Infections:
+        case SIRData::Recoveries:
+            BuildField(field);
+            return static_cast<ITS *>(series[(int)field]);
+        default:                   return nullptr;
+    }
+}
+
+// Specialization for TimeStatistics
+template <>
+TSx *FullRecorder::GetData<TSx>(SIRData field)
+{
+    BuildField(field);
+    return statistics[(int)field];
+}
+
+// Specialization for PyramidTimeSeries
+template <>
+PyTS *FullRecorder::GetData<PyTS>(SIRData field)
+{
+    BuildField(field);
+    return pyramids[(int)field];
+}
+
+// Specialization for PyramidData
+template <>
+PyramidData<double> *FullRecorder::GetData<PyramidData<double>>(SIRData field)
+{
+    if (field != SIRData::Infections)
+        return nullptr;
+
+    CalculateInfectionAgePercent();
+    return InfectionsAgePercent;
+}
+
+StreamingRecorder::StreamingRecorder(uint tMax, uint pLength, vector<double> ageBreaks,
+                                     SIRDataMask outputs)
+  : pLength(pLength), outputs(outputs), sink(nullptr), closed(false)
+{
+    profileAgeBreaks.assign(begin(ProfileAgeBreaks), end(ProfileAgeBreaks));
+
+    nPeriods        = tMax / pLength + 1;
+    nAgeGroups      = (int)ageBreaks.size() + 1;
+    ageGroup        = AgeGroupTable(ageBreaks, MaxAge);
+    profileAgeGroup = AgeGroupTable(profileAgeBreaks, MaxAge);
+
+    ring.assign(nSlots * nFields * nSexes * nAgeGroups, 0);
+    first = 0;
+    levels.assign(nFields * nSexes * nAgeGroups, 0);
+    infectionsProfile.assign(profileAgeBreaks.size() + 1, 0);
+    populationProfile.assign(profileAgeBreaks.size() + 1, 0);
+
+    InfectionsAgePercent = nullptr;
+}
+
+StreamingRecorder::~StreamingRecorder(void)
+{
+    delete InfectionsAgePercent;
+}
+
+void StreamingRecorder::ClosePeriods(uint until)
+{
+    int fieldSize = nSexes * nAgeGroups;
+    int slotSize  = nFields * fieldSize;
+    int totals[nFields];
+
+    for (; first < until; first++) {
+        int *slot = ring.data() + (first % nSlots) * slotSize;
+
+        // Carry the count of each prevalence cell into the period, and sum
+        //   each field over sex and age group
+        for (int field = 0; field < nFields; field++) {
+            int *cell     = slot + field * fieldSize;
+            int *level    = levels.data() + field * fieldSize;
+            totals[field] = 0;
+
+            if (IsPrevalence((SIRData)field))
+                for (int i = 0; i < fieldSize; i++)
+                    cell[i] = level[i] += cell[i];
+
+            for (int i = 0; i < fieldSize; i++)
+                totals[field] += cell[i];
+        }
+
+        if (sink)
+            sink->ClosePeriod(first, totals, slot, nAgeGroups);
+
+        fill(slot, slot + slotSize, 0);
+    }
+}
+
+void StreamingRecorder::Close(void)
+{
+    ClosePeriods(nPeriods);
+    closed = true;
+}
+
+template <>
+PyramidData<double> *StreamingRecorder::GetData<PyramidData<double>>(SIRData field)
+{
+    if (field != SIRData::Infections)
+        return nullptr;
+    if (!closed)
+        throw out_of_range("GetData before Close()");
+    if (!(outputs & SIRDataBit(SIRData::Infections)))
+        return nullptr;
+
+    if (!InfectionsAgePercent)
+        InfectionsAgePercent = AgePercent(infectionsProfile.data(), profileAgeBreaks);
+
+    return InfectionsAgePercent;
+}
+
+InfectionsRecorder::InfectionsRecorder(uint tMax, uint pLength, vector<double> ageBreaks,
+                                       SIRDataMask outputs)
+  : pLength((int)pLength)
+{
+    InfectionsSx = new DTSx("Infections");
+    Infections   = new ITS("Infections", 0, tMax, pLength, 1, InfectionsSx);
+
+    pending       = 0;
+    pendingPeriod = 0;
+    pendingTime   = 0;
+}
+
+InfectionsRecorder::~InfectionsRecorder(void)
+{
+    delete Infections;
+    delete InfectionsSx;
+}
+
+bool InfectionsRecorder::Flush(void)
+{
+    if (pending == 0)
+        return true;
+
+    bool success = Infections->Record(pendingTime, pending);
+    pending = 0;
+    return success;
+}
+
+void InfectionsRecorder::Close(void)
+{
+    Flush();
+    Infections->Close();
+}
+
+template <>
+TS *InfectionsRecorder::GetData<TS>(SIRData field)
+{
+    return field == SIRData::Infections ? Infections : nullptr;
+}
+
+template <>
+PrevalenceTimeSeries<int> *InfectionsRecorder::GetData<PrevalenceTimeSeries<int>>(SIRData field)
+{
+    return nullptr;
+}
+
+template <>
+IncidenceTimeSeries<int> *InfectionsRecorder::GetData<IncidenceTimeSeries<int>>(SIRData field)
+{
+    return field == SIRData::Infections ? Infections : nullptr;
+}
+
+template <>
+TSx *InfectionsRecorder::GetData<TSx>(SIRData field)
+{
+    return field == SIRData::Infections ? InfectionsSx : nullptr;
+}
+
+template <>
+PyTS *InfectionsRecorder::GetData<PyTS>(SIRData field)
+{
+    return nullptr;
+}
+
+template <>
+PyramidData<double> *InfectionsRecorder::GetData<PyramidData<double>>(SIRData field)
+{
+    return nullptr;
+}
@@ -1,8 +1,10 @@
+#include <algorithm>
 #include <cstdio>
+#include <limits>
+#include <cmath>
+#include <queue>
 #include <stdexcept>
 
-#include <EventQueue.h>
-
 #include "../include/SIRlib/SIRlib.h"
 #include "../include/SIRlib/Individual.h"
 
@@ -14,32 +16,22 @@ using namespace SIRlib;
 // Alias for unsigned integers
 using uint = unsigned int;
 
-// Aliases for EventQueue
-using EQ         = SIRSimulation::EQ;
-using EventFunc  = EQ::EventFunc;
-using SchedulerT = EQ::SchedulerT;
-
-using PeopleT = SIRSimulation::PeopleT;
-using AgeT    = SIRSimulation::AgeT;
-using DayT    = SIRSimulation::DayT;
-
-// Aliases for specialized data structures
-using CTSx = ContinuousTimeStatistic;
-using DTSx = DiscreteTimeStatistic;
-using PTS  = PrevalenceTimeSeries<int>;
-using PPTS = PrevalencePyramidTimeSeries;
-using ITS  = IncidenceTimeSeries<int>;
-using IPTS = IncidencePyramidTimeSeries;
-
-// Aliases for unspecialized data structures
-using TS   = TimeSeries<int>;
-using TSx  = TimeStatistic;
-using PyTS = PyramidTimeSeries;
-
-SIRSimulation::SIRSimulation(RNG *_rng, double _lambda, double _gamma, uint _nPeople, \
-                             uint _ageMin, uint _ageMax, uint _ageBreak,     \
-                             uint _tMax, uint _deltaT,                           \
-                             uint _pLength)
+// Every member below is defined for any combination of policies. The
+//   combinations shipped with the library are instantiated at the bottom of
+//   this file.
+#define SIR_TEMPLATE template <typename RecorderPolicy, typename FOIPolicy, typename QueuePolicy>
+#define SIR_CLASS    BasicSIRSimulation<RecorderPolicy, FOIPolicy, QueuePolicy>
+
+SIR_TEMPLATE constexpr typename SIR_CLASS::PeopleT SIR_CLASS::FOIBlockSize;
+SIR_TEMPLATE constexpr typename SIR_CLASS::PeopleT SIR_CLASS::FOIChunkSize;
+SIR_TEMPLATE constexpr double SIR_CLASS::TauLeapMinEvents;
+SIR_TEMPLATE constexpr int    SIR_CLASS::TauLeapExactSteps;
+
+SIR_TEMPLATE
+SIR_CLASS::BasicSIRSimulation(RNG *_rng, double _lambda, double _gamma, uint _nPeople, \
+                              uint _ageMin, uint _ageMax, uint _ageBreak,     \
+                              uint _tMax, uint _deltaT,                           \
+                              uint _pLength, SIRDataMask _outputs)
 {
     rng      = _rng;
     lambda        = _lambda;
@@ -51,6 +43,23 @@ SIRSimulation::SIRSimulation(RNG *_rng, double _lambda, double _gamma, uint _nPe
     tMax     = (DayT)_tMax;
     deltaT       = (DayT)_deltaT;
     pLength  = (DayT)_pLength;
+    foiMode  = FOIMode::PerIndividual;
+    runMode  = RunMode::Individual;
+    tauLeapEpsilon = 0.03;
+    hybridToAggregate  = 1000;
+    hybridToIndividual = 100;
+    lazyPopulation     = false;
+    foiThreads         = 0;
+    nPartitions        = 1;
+    partitionThreads   = 1;
+    foiPool            = nullptr;
+    partitionPool      = new ThreadPool(1);
+    adaptiveFOIStep    = false;
+    foiStep            = deltaT;
+    lastFOIInfected    = 0;
+    infectiveTime      = 0;
+    infectiveTimeAt    = 0;
+    foiExcess          = 0;
 
     // Check to make sure parameters satisfy constraints
     if (rng == nullptr)
@@ -63,6 +72,8 @@ SIRSimulation::SIRSimulation(RNG *_rng, double _lambda, double _gamma, uint _nPe
         throw out_of_range("'nPeople' < 1");
     if (!(ageMin <= ageMax))
         throw out_of_range("ageMin > ageMax");
+    if (ageMax > MaxAge)
+        throw out_of_range("ageMax > MaxAge");
     if (ageBreak < 1)
         throw out_of_range("ageBreak < 1");
     if (ageBreak >= (ageMax-ageMin))
@@ -89,32 +100,8 @@ SIRSimulation::SIRSimulation(RNG *_rng, double _lambda, double _gamma, uint _nPe
 
     // --- Instantiate data structures ---
 
-    // Create statistics data structures
-    SusceptibleSx = new CTSx("Susceptible");
-    InfectedSx    = new CTSx("Infected");
-    RecoveredSx   = new CTSx("Recovered");
-    InfectionsSx  = new DTSx("Infections");
-    RecoveriesSx  = new DTSx("Recoveries");
-
-    // Create PrevalenceTimeSeries and IncidenceTimeSeries structures
-    Susceptible = new PTS("Susceptible",   (uint)tMax, (uint)pLength, 1, SusceptibleSx);
-    Infected    = new PTS("Infected" ,     (uint)tMax, (uint)pLength, 1, InfectedSx);
-    Recovered   = new PTS("Recovered",     (uint)tMax, (uint)pLength, 1, RecoveredSx);
-    Infections  = new ITS("Infections", 0, (uint)tMax, (uint)pLength, 1, InfectionsSx);
-    Recoveries  = new ITS("Recoveries", 0, (uint)tMax, (uint)pLength, 1, RecoveriesSx);
-
-    // Create PrevalencePyramidTimeSeries and IncidencePyramidTimeSeries structures
-    SusceptiblePyr = new PPTS("Susceptible", 0, (uint)tMax, (uint)pLength, 2, ageBreaks);
-    InfectedPyr    = new PPTS("Infected",    0, (uint)tMax, (uint)pLength, 2, ageBreaks);
-    RecoveredPyr   = new PPTS("Recovered",   0, (uint)tMax, (uint)pLength, 2, ageBreaks);
-    InfectionsPyr  = new IPTS("Infections",  0, (uint)tMax, (uint)pLength, 2, ageBreaks);
-    RecoveriesPyr  = new IPTS("Recoveries",  0, (uint)tMax, (uint)pLength, 2, ageBreaks);
-
-    // Create PyramidData for storing age distribution of infected people
-    vector<double> fixedAgeBreaks = {4,18,24,40};
-    TotalAgeCounts       = new PyramidData<int>(1, fixedAgeBreaks);
-    InfectionsAgeCounts  = new PyramidData<int>(1, fixedAgeBreaks);
-    InfectionsAgePercent = new PyramidData<double>(1, fixedAgeBreaks);
+    recorder  = new RecorderPolicy((uint)tMax, (uint)pLength, ageBreaks, _outputs);
+    nInfected = 0;
 
     // --- Instantiate statistical distributions ---
 
@@ -127,358 +114,1261 @@ SIRSimulation::SIRSimulation(RNG *_rng, double _lambda, double _gamma, uint _nPe
     // "Coin-flip" distribution on sex
     sexDist = new StatisticalDistributions::Bernoulli(0.5);
 
-    // Create event queue
-    eq = new EQ{};
+    // Uniform distribution on [0, 1), used for sampling without replacement
+    //   and for placing infections within a step
+    unitDist = new StatisticalDistributions::Uniform(0, 1);
+
+    // Create counts used by the aggregate engines
+    SusceptibleCounts = AgeSexCounts(ageMin, ageMax);
+    InfectedCounts    = AgeSexCounts(ageMin, ageMax);
+
+    // Create event queue and store of recoveries
+    eq         = new EQ{tMax};
+    recoveries = new RecoveryStore{tMax};
+    nextFOIUpdate = 0;
 }
 
-SIRSimulation::~SIRSimulation()
+SIR_TEMPLATE
+SIR_CLASS::~BasicSIRSimulation()
 {
-    delete Susceptible;
-    delete Infected;
-    delete Recovered;
-    delete Infections;
-    delete Recoveries;
-
-    delete SusceptibleSx;
-    delete InfectedSx;
-    delete RecoveredSx;
-    delete InfectionsSx;
-    delete RecoveriesSx;
-
-    delete SusceptiblePyr;
-    delete InfectedPyr;
-    delete RecoveredPyr;
-    delete InfectionsPyr;
-    delete RecoveriesPyr;
-
-    delete InfectionsAgeCounts;
-    delete InfectionsAgePercent;
+    delete recorder;
 
     delete timeToRecoveryDist;
     delete ageDist;
     delete sexDist;
+    delete unitDist;
 
     delete eq;
+    delete recoveries;
+
+    delete foiPool;
+    delete partitionPool;
 }
 
-bool SIRSimulation::IdvIncrement(DayT t, SIRData dtype, Individual idv, int increment) {
+SIR_TEMPLATE
+void SIR_CLASS::SetFOIMode(FOIMode mode) {
+    foiMode = mode;
+}
+
+SIR_TEMPLATE
+void SIR_CLASS::SetRunMode(RunMode mode) {
+    runMode = mode;
+}
+
+SIR_TEMPLATE
+void SIR_CLASS::SetTauLeapEpsilon(double epsilon) {
+    if (epsilon <= 0 || epsilon >= 1)
+        throw out_of_range("epsilon was <= 0 or >= 1");
+
+    tauLeapEpsilon = epsilon;
+}
+
+SIR_TEMPLATE
+void SIR_CLASS::SetHybridThresholds(PeopleT toAggregate, PeopleT toIndividual) {
+    if (toIndividual >= toAggregate)
+        throw out_of_range("toIndividual >= toAggregate");
+
+    hybridToAggregate  = toAggregate;
+    hybridToIndividual = toIndividual;
+}
+
+SIR_TEMPLATE
+void SIR_CLASS::SetLazyPopulation(bool lazy) {
+    lazyPopulation = lazy;
+}
+
+SIR_TEMPLATE
+void SIR_CLASS::SetFOIThreads(uint nThreads) {
+    foiThreads = nThreads;
+
+    // The workers are started here, once, and reused by every FOI update
+    delete foiPool;
+    foiPool = nThreads > 0 ? new ThreadPool(nThreads) : nullptr;
+}
+
+SIR_TEMPLATE
+void SIR_CLASS::SetPartitions(uint _nPartitions, uint nThreads) {
+    if (_nPartitions < 1)
+        throw out_of_range("nPartitions < 1");
+    if (nThreads < 1)
+        throw out_of_range("nThreads < 1");
+
+    nPartitions      = _nPartitions;
+    partitionThreads = nThreads;
+
+    delete partitionPool;
+    partitionPool = new ThreadPool(nThreads);
+}
+
+SIR_TEMPLATE
+void SIR_CLASS::SetAdaptiveFOIStep(DayT minStep, DayT maxStep, double tolerance) {
+    if (minStep <= 0)
+        throw out_of_range("minStep <= 0");
+    if (maxStep < minStep)
+        throw out_of_range("maxStep < minStep");
+    if (tolerance <= 0)
+        throw out_of_range("tolerance <= 0");
+
+    adaptiveFOIStep = true;
+    foiMinStep      = minStep;
+    foiMaxStep      = maxStep;
+    foiTolerance    = tolerance;
+    foiStep         = minStep;
+}
+
+SIR_TEMPLATE
+template <SIRData D>
+bool SIR_CLASS::IdvIncrement(DayT t, Individual idv, int increment) {
     int floor_t;
     floor_t = (int) t;
 
-    // Potential improvement would be to use function pointers instead of
-    //   explicit calls to on each switch
-    switch (dtype) {
-        case SIRData::Susceptible:
-            return SusceptiblePyr->UpdateByAge(floor_t, sexN(idv.sex), idv.age, increment)
-                && Susceptible->Record(floor_t, increment);
-
-        case SIRData::Infected:
-            return InfectedPyr->UpdateByAge(floor_t, sexN(idv.sex), idv.age, increment)
-                && Infected->Record(floor_t, increment);
-
-        case SIRData::Recovered:
-            return RecoveredPyr->UpdateByAge(floor_t, sexN(idv.sex), idv.age, increment)
-                && Recovered->Record(floor_t, increment);
-
-        case SIRData::Infections:
-            return InfectionsPyr->UpdateByAge(floor_t, sexN(idv.sex), idv.age, increment)
-                && Infections->Record(floor_t, increment)
-                && InfectionsAgeCounts->UpdateByAge(0, idv.age, increment);
-                // ^ Increase number of infections in age group to calculate
-                //     percentages later on
-
-        case SIRData::Recoveries:
-            return RecoveriesPyr->UpdateByAge(floor_t, sexN(idv.sex), idv.age, increment)
-                && Recoveries->Record(floor_t, increment);
-
-        // Should never take this branch because the switch should cover every
-        //   member of the SIRData enum
-        default:
-            return false;
+    // 'D' is known at compile time, so this test and the choice of
+    //   datastores in the recorder cost nothing at runtime
+    if (D == SIRData::Infected) {
+        infectiveTime  += nInfected * (t - infectiveTimeAt);
+        infectiveTimeAt = t;
+        nInfected      += increment;
     }
-}
 
-EventFunc SIRSimulation::InfectionEvent(int individualIdx) {
-    if (individualIdx >= nPeople)
-        throw out_of_range("individualIdx >= nPeople");
+    return recorder->template Record<D>(floor_t, sexN(idv.sex), idv.age, increment);
+}
 
-    // printf("\t[unk] Infection: scheduled %d\n", individualIdx);
+SIR_TEMPLATE
+void SIR_CLASS::SwapSusceptibles(PeopleT i, PeopleT j) {
+    SwapInIndex(SusceptibleIdx, SusceptiblePos, 0, i, j);
+}
 
-    EventFunc ef =
-      [this,individualIdx](DayT t, SchedulerT Schedule) {
+SIR_TEMPLATE
+void SIR_CLASS::RemoveSusceptible(PeopleT individualIdx) {
+    RemoveFromIndex(SusceptibleIdx, SusceptiblePos, 0, individualIdx);
+}
 
-        // printf("[%f] Infection: infecting %d\n", t, individualIdx);
+SIR_TEMPLATE
+void SIR_CLASS::SwapInIndex(vector<PeopleT> &idx, vector<PeopleT> &pos,
+                            PeopleT base, PeopleT i, PeopleT j) {
+    PeopleT a = idx[i];
+    PeopleT b = idx[j];
 
-        // Grab individual from population to use traits of individual
-        Individual idv = Population.at(individualIdx);
+    idx[i] = b;
+    idx[j] = a;
+    pos[b - base] = i;
+    pos[a - base] = j;
+}
 
-        // Decrease susceptible quantity, increase infected quantity
-        IdvIncrement(t, SIRData::Susceptible, idv, -1);
-        IdvIncrement(t, SIRData::Infected, idv, +1);
-        IdvIncrement(t, SIRData::Infections, idv, +1);
+SIR_TEMPLATE
+void SIR_CLASS::RemoveFromIndex(vector<PeopleT> &idx, vector<PeopleT> &pos,
+                                PeopleT base, PeopleT individualIdx) {
+    PeopleT at   = pos[individualIdx - base];
+    PeopleT last = idx.back();
 
-        // Create recovery event
-        auto recoveryEvent =
-          eq->MakeScheduledEvent(t + timeToRecovery(t), RecoveryEvent(individualIdx));
+    // Move the last susceptible into the vacated slot
+    idx[at] = last;
+    pos[last - base] = at;
 
-        // Schedule recovery of individual
-        Schedule(recoveryEvent);
+    idx.pop_back();
+}
 
-        // Register individual as Infected
-        Population[individualIdx] = changeHealthState(idv, HealthState::Infected);
+SIR_TEMPLATE
+void SIR_CLASS::Schedule(DayT t, SIREvent::Kind kind, PeopleT individualIdx) {
+    if (kind != SIREvent::Kind::FOIUpdate && individualIdx >= nPeople)
+        throw out_of_range("individualIdx >= nPeople");
 
-        // Announce success
-        return true;
-    };
+    if (kind == SIREvent::Kind::FOIUpdate)
+        nextFOIUpdate = t;
 
-    return ef;
+    eq->Schedule(SIREvent{t, (uint32_t)individualIdx, kind});
 }
 
-EventFunc SIRSimulation::RecoveryEvent(int individualIdx) {
+SIR_TEMPLATE
+void SIR_CLASS::ScheduleRecovery(DayT t, PeopleT individualIdx) {
     if (individualIdx >= nPeople)
         throw out_of_range("individualIdx >= nPeople");
 
-    // printf("\t[unk] Recovery: scheduled %d\n", individualIdx);
+    recoveries->Schedule(Recovery{t, (uint32_t)individualIdx});
+}
+
+SIR_TEMPLATE
+void SIR_CLASS::RunEvent(const SIREvent &e) {
+    switch (e.kind) {
+        case SIREvent::Kind::Infection:
+            InfectionEvent(e.t, e.idx);
+            break;
 
-    EventFunc ef =
-      [this, individualIdx](DayT t, SchedulerT Schedule) {
+        case SIREvent::Kind::FOIUpdate:
+            FOIUpdateEvent(e.t);
+            break;
+    }
+}
 
-        // printf("[%f] Recovery: recovered %d\n", t, individualIdx);
+SIR_TEMPLATE
+void SIR_CLASS::InfectionEvent(DayT t, PeopleT individualIdx) {
 
-        // Grab individual to take advantage of their characteristics
-        Individual idv = Population.at(individualIdx);
+    // printf("[%f] Infection: infecting %d\n", t, individualIdx);
 
-        // Reduce the number of Infectives
-        IdvIncrement(t, SIRData::Infected, idv, -1);
+    // Grab individual from population to use traits of individual
+    Individual idv = Population.Get(individualIdx);
 
-        // Increase the number of Recovered population members, and increase
-        //   the number of recoveries
-        IdvIncrement(t, SIRData::Recovered, idv, +1);
-        IdvIncrement(t, SIRData::Recoveries, idv, +1);
+    // A person can only be infected once
+    if (idv.hs != HealthState::Susceptible)
+        return;
 
-        // Register the Recovered status of the individual in the Population
-        //   vector.
-        Population[individualIdx] = changeHealthState(idv, HealthState::Recovered);
+    // Decrease susceptible quantity, increase infected quantity
+    IdvIncrement<SIRData::Susceptible>(t, idv, -1);
+    IdvIncrement<SIRData::Infected>(t, idv, +1);
+    IdvIncrement<SIRData::Infections>(t, idv, +1);
 
-        // Announce success
-        return true;
-    };
+    // Schedule recovery of individual
+    ScheduleRecovery(t + timeToRecovery(t), individualIdx);
 
-    return ef;
+    // Register individual as Infected, and drop them from the index of
+    //   susceptibles
+    Population.SetHealthState(individualIdx, HealthState::Infected);
+    if (!lazyPopulation)
+        RemoveSusceptible(individualIdx);
 }
 
-EventFunc SIRSimulation::FOIUpdateEvent() {
-    EventFunc ef =
-     [this](DayT t, SchedulerT Schedule) {
+SIR_TEMPLATE
+void SIR_CLASS::RecoveryEvent(DayT t, PeopleT individualIdx) {
 
-        // For each individual, schedule infection if timeToInfection(t) < deltaT
-        int idvIndex = 0;
-        DayT ttI;
+    // printf("[%f] Recovery: recovered %d\n", t, individualIdx);
 
-        // Iterate through each individual
-        for (auto individual : Population) {
+    // Grab individual to take advantage of their characteristics
+    Individual idv = Population.Get(individualIdx);
 
-            // If they are susceptible, and timeToInfection(t) < deltaT, schedule
-            //   infection
-            if (individual.hs == HealthState::Susceptible &&
-                (ttI = timeToInfection(t)) < deltaT)
-                Schedule(eq->MakeScheduledEvent(t + ttI, InfectionEvent(idvIndex)));
-            idvIndex += 1;
-        }
+    // Reduce the number of Infectives
+    IdvIncrement<SIRData::Infected>(t, idv, -1);
+
+    // Increase the number of Recovered population members, and increase
+    //   the number of recoveries
+    IdvIncrement<SIRData::Recovered>(t, idv, +1);
+    IdvIncrement<SIRData::Recoveries>(t, idv, +1);
+
+    // Register the Recovered status of the individual in the Population
+    //   vector.
+    Population.SetHealthState(individualIdx, HealthState::Recovered);
+}
 
-        // Create next UpdateFOIEvent
-        auto UpdateFOIEvent =
-          eq->MakeScheduledEvent(t + deltaT, FOIUpdateEvent());
+SIR_TEMPLATE
+void SIR_CLASS::FOIUpdateEvent(DayT t) {
 
-        // Schedule next UpdateFOI
-        Schedule(UpdateFOIEvent);
+    // Choose the length of this step, then draw the infections occurring in
+    //   [t, t + foiStep)
+    NextFOIStep(t);
+
+    if (lazyPopulation)
+        DrawInfectionsLazy(t);
+    else switch (foiMode) {
+        case FOIMode::PerIndividual:
+            DrawInfectionsPerIndividual(t);
+            break;
+
+        case FOIMode::Binomial:
+            DrawInfectionsBinomial(t);
+            break;
+    }
 
-        // Announce success
-        return true;
-    };
+    // Schedule them all at once
+    eq->ScheduleBulk(newInfections.data(), newInfections.size());
+    newInfections.clear();
 
-    return ef;
+    // Schedule next UpdateFOI
+    Schedule(t + foiStep, SIREvent::Kind::FOIUpdate, 0);
 }
 
-DayT SIRSimulation::timeToInfection(DayT t) {
-    // Needs to be sampled from an exponential distribution
+SIR_TEMPLATE
+void SIR_CLASS::DrawInfectionsPerIndividual(DayT t) {
+    stats.foiDraws += SusceptibleIdx.size();
 
-    double forceOfInfection;
+    if (foiThreads > 0) {
+        DrawInfectionsChunked(t);
+        return;
+    }
 
-    auto N = [this] (DayT t) -> double { return nPeople; };
+    SweepSusceptibles(t, forceOfInfection(t), SusceptibleIdx.data(),
+                      SusceptibleIdx.size(), *rng, *unitDist, newInfections);
+}
 
-    forceOfInfection = lambda * ((*Infected)(t) / N(t));
+SIR_TEMPLATE
+void SIR_CLASS::DrawInfectionsChunked(DayT t) {
+    PeopleT nSusceptible = SusceptibleIdx.size();
+    PeopleT nChunks      = (nSusceptible + FOIChunkSize - 1) / FOIChunkSize;
+    double  foi          = forceOfInfection(t);
+
+    // A single draw from 'rng' seeds the substreams of every chunk, so 'rng'
+    //   advances the same way whatever the number of threads
+    uint64_t seed = rng->mt_();
+
+    if (chunkInfections.size() < nChunks)
+        chunkInfections.resize(nChunks);
+
+    // Which thread sweeps a chunk makes no difference to its infections
+    foiPool->ParallelFor(nChunks, [&] (uint c) {
+        RNG chunkRNG(ChunkSeed(seed, c));
+        StatisticalDistributions::Uniform unit(0, 1);
+
+        PeopleT begin = c * FOIChunkSize;
+        PeopleT n     = nSusceptible - begin < FOIChunkSize ? \
+                          nSusceptible - begin : FOIChunkSize;
+
+        chunkInfections[c].clear();
+        SweepSusceptibles(t, foi, SusceptibleIdx.data() + begin, n,
+                          chunkRNG, unit, chunkInfections[c]);
+    });
+
+    // Merge the infections of each chunk in order of chunk
+    for (PeopleT c = 0; c < nChunks; c++)
+        newInfections.insert(newInfections.end(),
+                             chunkInfections[c].begin(), chunkInfections[c].end());
+}
+
+SIR_TEMPLATE
+uint64_t SIR_CLASS::ChunkSeed(uint64_t seed, PeopleT chunk) {
+    // SplitMix64 finalizer, so that neighbouring chunks get unrelated seeds
+    uint64_t z = seed + (chunk + 1) * 0x9E3779B97F4A7C15ULL;
 
-    // Return sample from distribution
-    return (DayT)StatisticalDistributions::Exponential(forceOfInfection) \
-             .Sample(*rng);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
 }
 
-// Right now, actually doesn't depend on 't'.
-DayT SIRSimulation::timeToRecovery(DayT t) {
-    return (DayT)timeToRecoveryDist->Sample(*rng);
+SIR_TEMPLATE
+void SIR_CLASS::SweepSusceptibles(DayT t, double foi, const PeopleT *idx, PeopleT n,
+                                  RNG &r, StatisticalDistributions::Uniform &unit,
+                                  vector<SIREvent> &infections) {
+    DayT ttIs[FOIBlockSize];
+
+    // Walk the index of susceptibles a block at a time, drawing the times to
+    //   infection of the whole block at once, and schedule infection of those
+    //   with a time to infection < foiStep. Infections are scheduled strictly
+    //   after 't', so the index is not modified while we walk it.
+    for (PeopleT start = 0; start < n; start += FOIBlockSize) {
+        PeopleT m = n - start < FOIBlockSize ? \
+                      n - start : FOIBlockSize;
+
+        timesToInfection(foi, ttIs, m, r, unit);
+
+        for (PeopleT k = 0; k < m; k++)
+            if (ttIs[k] < foiStep)
+                infections.push_back(SIREvent{t + ttIs[k],
+                                              (uint32_t)idx[start + k],
+                                              SIREvent::Kind::Infection});
+    }
 }
 
-void SIRSimulation::CalculateInfectionAgePercent(void) {
-    int nAgeBreaks;
-    // nAgeBreaks = (int) ceil((double)(ageMax-ageMin)/(double)ageBreak);
-    nAgeBreaks = 5;
+SIR_TEMPLATE
+void SIR_CLASS::DrawInfectionsBinomial(DayT t) {
+    ThinSusceptibles(t, forceOfInfection(t), SusceptibleIdx, SusceptiblePos, 0,
+                     *rng, *unitDist, newInfections);
+
+    stats.foiDraws += newInfections.size();
+}
 
-    for (int i = 0; i < nAgeBreaks; i++) {
-        double percent = (double) InfectionsAgeCounts->GetTotalInAgeGroupAndCategory(i,0) / \
-                         (double) Infections->GetTotal();
-        InfectionsAgePercent->UpdateByIdx(0, i, percent);
+SIR_TEMPLATE
+void SIR_CLASS::ThinSusceptibles(DayT t, double foi, vector<PeopleT> &idx,
+                                 vector<PeopleT> &pos, PeopleT base, RNG &r,
+                                 StatisticalDistributions::Uniform &unit,
+                                 vector<SIREvent> &infections) {
+    PeopleT nSusceptible = idx.size();
+    PeopleT nNew         = 0;
+
+    double pInfection    = 1 - exp(-foi * foiStep);
+
+    // Draw the number of susceptibles infected during the step
+    if (nSusceptible > 0 && pInfection > 0)
+        nNew = (PeopleT)StatisticalDistributions::Binomial(nSusceptible, pInfection) \
+                 .Sample(r);
+
+    // Choose who is infected by a partial Fisher-Yates shuffle of the index
+    //   of susceptibles: after iteration 'i', positions [0, i] hold the
+    //   chosen individuals. Each is infected at a uniform offset into the
+    //   step.
+    for (PeopleT i = 0; i < nNew; i++) {
+        PeopleT j = i + (PeopleT)(unit.Sample(r) * (nSusceptible - i));
+        if (j >= nSusceptible)
+            j = nSusceptible - 1;
+
+        SwapInIndex(idx, pos, base, i, j);
+
+        DayT ttI = (DayT)unit.Sample(r) * foiStep;
+        infections.push_back(SIREvent{t + ttI, (uint32_t)idx[i],
+                                      SIREvent::Kind::Infection});
     }
-    return;
 }
 
-bool SIRSimulation::Run(void)
-{
-    // Create 'nPeople' susceptible individuals and increase the count of
-    //   susceptibles
-    for (PeopleT i = 0; i < nPeople; i++) {
+SIR_TEMPLATE
+void SIR_CLASS::DrawInfectionsLazy(DayT t) {
+    AgeSexCounts::CountT nSusceptible = SusceptibleCounts.Total();
+    PeopleT nNew                      = 0;
+
+    double pInfection = 1 - exp(-forceOfInfection(t) * foiStep);
+
+    // Draw the number of susceptibles infected during the step
+    if (nSusceptible > 0 && pInfection > 0)
+        nNew = (PeopleT)StatisticalDistributions::Binomial(nSusceptible, pInfection) \
+                 .Sample(*rng);
+
+    // Materialize each of them, and infect them at a uniform offset into the
+    //   step
+    for (PeopleT i = 0; i < nNew; i++) {
+        PeopleT idvIndex = MaterializeSusceptible();
 
-        auto idv = newIndividual(rng, ageDist, sexDist, HealthState::Susceptible);
+        DayT ttI = (DayT)unitDist->Sample(*rng) * foiStep;
+        newInfections.push_back(SIREvent{t + ttI, (uint32_t)idvIndex,
+                                         SIREvent::Kind::Infection});
+    }
+
+    stats.foiDraws += nNew;
+}
+
+SIR_TEMPLATE
+typename SIR_CLASS::PeopleT SIR_CLASS::MaterializeSusceptible(void) {
+    auto cell = SusceptibleCounts.Sample(unitDist->Sample(*rng));
+
+    SusceptibleCounts.Add(cell, -1);
+    stats.peopleCreated++;
+    return Population.PushBack(CellIndividual(cell, HealthState::Susceptible));
+}
+
+SIR_TEMPLATE
+typename SIR_CLASS::DayT SIR_CLASS::NextFOIStep(DayT t) {
+    if (adaptiveFOIStep) {
+
+        // Relative change in the number of infectives over the last step
+        double change = fabs((double)nInfected - (double)lastFOIInfected) \
+                          / max((double)lastFOIInfected, 1.0);
+
+        // Scale the step so that the change over the next one is expected
+        //   to be near 'foiTolerance', growing it at most twofold per update
+        DayT step = change > 0 ? foiStep * foiTolerance / change : foiMaxStep;
 
-        Population.push_back(idv);
-        IdvIncrement(0, SIRData::Susceptible, idv, +1);
+        step = min(step, 2 * foiStep);
+        step = min(max(step, foiMinStep), foiMaxStep);
 
-        // Add person to total age count
-        TotalAgeCounts->UpdateByAge(0, idv.age, +1);
+        foiStep         = step;
+        lastFOIInfected = nInfected;
     }
 
+    stats.foiSteps.push_back(FOIStep{t, foiStep, nInfected});
+
+    return foiStep;
+}
+
+SIR_TEMPLATE
+double SIR_CLASS::forceOfInfection(DayT t) {
+    auto N = [this] (DayT t) -> double { return nPeople; };
+
+    if (!adaptiveFOIStep)
+        return FOIPolicy::ForceOfInfection(lambda, nInfected, N(t));
+
+    // Holding the force of infection over a step charges each infective for
+    //   the whole step, although they may recover during it, while people
+    //   infected during it only transmit from the next update. With a fixed
+    //   step the two cancel on average, but not once the step varies, or is
+    //   longer than the infectious period. So charge the person-time the
+    //   infectives are expected to be infectious for over the step, plus
+    //   whatever the infectious person-time since the last update exceeded
+    //   the charge for it.
+    foiExcess -= infectiveTime + nInfected * (t - infectiveTimeAt);
+    ResetFOIAccount(t);
+
+    double charge = nInfected * gamma * (1 - exp(-foiStep / gamma)) - foiExcess;
+    charge     = max(charge, 0.0);
+    foiExcess += charge;
+
+    return FOIPolicy::ForceOfInfection(lambda, charge / foiStep, N(t));
+}
+
+SIR_TEMPLATE
+void SIR_CLASS::ResetFOIAccount(DayT t) {
+    infectiveTime   = 0;
+    infectiveTimeAt = t;
+}
 
+SIR_TEMPLATE
+void SIR_CLASS::timesToInfection(double foi, DayT *ttIs, PeopleT n,
+                                 RNG &r, StatisticalDistributions::Uniform &unit) {
+    // Draw uniforms on (0, 1], then transform the whole block into
+    //   exponential variates of rate 'foi'
+    for (PeopleT i = 0; i < n; i++)
+        ttIs[i] = 1 - (DayT)unit.Sample(r);
+
+    ExponentialFromUniforms(ttIs, ttIs, n, foi);
+}
+
+// Right now, actually doesn't depend on 't'.
+SIR_TEMPLATE
+typename SIR_CLASS::DayT SIR_CLASS::timeToRecovery(DayT t) {
+    return (DayT)timeToRecoveryDist->Sample(*rng);
+}
+
+SIR_TEMPLATE
+void SIR_CLASS::InitPopulation(void)
+{
     // Calculate time of first infection, and just after, the first FOIUpdate.
     // We assume that the individual with idx=0 is the first to be infected.
     DayT    timeOfFirstInfection   = 0;
     PeopleT firstInfectiousCaseIdx = 0;
     DayT    timeOfFirstFOI         = timeOfFirstInfection + 0.001;
 
-    auto firstInfection =
-      eq->MakeScheduledEvent(timeOfFirstInfection, InfectionEvent(firstInfectiousCaseIdx));
-    auto firstFOI =
-      eq->MakeScheduledEvent(timeOfFirstFOI, FOIUpdateEvent());
+    if (lazyPopulation) {
 
+        // Only the first case is materialized
+        InitCounts();
+        firstInfectiousCaseIdx = MaterializeSusceptible();
 
-    // Schedule these first two events
-    eq->Schedule(firstInfection);
-    eq->Schedule(firstFOI);
+    } else {
 
+        Population.Reserve(nPeople);
+        SusceptibleIdx.reserve(nPeople);
+        SusceptiblePos.resize(nPeople);
 
-    // While there is an event on the calendar
-    while(!eq->Empty()) {
+        // Create 'nPeople' susceptible individuals and increase the count of
+        //   susceptibles
+        for (PeopleT i = 0; i < nPeople; i++) {
 
-        // Grab the next event
-        auto e = eq->Top();
+            auto idv = newIndividual(rng, ageDist, sexDist, HealthState::Susceptible);
 
-        // Break if reached 'tMax'
-        if (e->t >= tMax)
-            break;
+            Population.PushBack(idv);
+            stats.peopleCreated++;
+            SusceptiblePos[i] = i;
+            SusceptibleIdx.push_back(i);
+            IdvIncrement<SIRData::Susceptible>(0, idv, +1);
+
+            // Add person to total age count
+            recorder->RecordTotalAge(idv.age, +1);
+        }
+    }
+
+    // Schedule the first infection and the first FOIUpdate
+    Schedule(timeOfFirstInfection, SIREvent::Kind::Infection, firstInfectiousCaseIdx);
+    Schedule(timeOfFirstFOI, SIREvent::Kind::FOIUpdate, 0);
+}
+
+SIR_TEMPLATE
+typename SIR_CLASS::DayT SIR_CLASS::NextTime(void)
+{
+    DayT tNext = numeric_limits<DayT>::infinity();
 
-        // Run the event
-        e->run();
+    if (!eq->Empty())
+        tNext = eq->Top().t;
+    if (!recoveries->Empty() && recoveries->Top().t < tNext)
+        tNext = recoveries->Top().t;
+
+    return tNext;
+}
+
+SIR_TEMPLATE
+void SIR_CLASS::RunNext(DayT &t)
+{
+    // Merge the event queue and the store of recoveries: the earlier of
+    //   their first entries runs next
+    bool isRecovery = !recoveries->Empty() &&
+                      (eq->Empty() || recoveries->Top().t < eq->Top().t);
+
+    if (isRecovery) {
+        Recovery r = recoveries->Top();
+
+        recoveries->Pop();
+        t = r.t;
+        RecoveryEvent(t, r.idx);
+    } else {
+        SIREvent e = eq->Top();
+
+        // Remove event from the queue, then run it. The event is a copy, so
+        //   the events it schedules cannot disturb it.
+        eq->Pop();
+        t = e.t;
+        RunEvent(e);
+    }
+}
+
+SIR_TEMPLATE
+bool SIR_CLASS::AdvanceIndividual(DayT &t, PeopleT stopAt)
+{
+    // While there is an event or a recovery on the calendar before 'tMax'
+    while (NextTime() < tMax) {
+
+        // Run a batch: the next entry, and every entry after it up to the
+        //   next FOIUpdateEvent, back to back. Only the count of infectives
+        //   is checked between entries, as the run ends as soon as the
+        //   last of them recovers.
+        DayT tEnd;
+        do {
+            RunNext(t);
+            tEnd = min(nextFOIUpdate, tMax);
+        } while (nInfected > 0 && NextTime() < tEnd);
 
         // Check that there are any infected people left
         // If not, break
-        if (Infected->GetCurrentPrevalence() == 0)
+        if (nInfected == 0)
+            break;
+
+        // Stop if the number of infectives has reached 'stopAt'
+        if ((PeopleT)nInfected >= stopAt)
+            return true;
+    }
+
+    return false;
+}
+
+SIR_TEMPLATE
+void SIR_CLASS::RunIndividual(void)
+{
+    DayT t = 0;
+
+    InitPopulation();
+    AdvanceIndividual(t, numeric_limits<PeopleT>::max());
+}
+
+SIR_TEMPLATE
+void SIR_CLASS::PopulationToCounts(void)
+{
+    // With a lazy population, 'SusceptibleCounts' already holds everyone not
+    //   materialized, and those materialized are handed back to it
+    if (!lazyPopulation)
+        SusceptibleCounts.Clear();
+    InfectedCounts.Clear();
+
+    for (PeopleT i = 0; i < Population.Size(); i++) {
+        auto hs   = Population.GetHealthState(i);
+        auto cell = SusceptibleCounts.Cell(sexN(Population.GetSex(i)), Population.GetAge(i));
+
+        if (hs == HealthState::Susceptible)
+            SusceptibleCounts.Add(cell, +1);
+        else if (hs == HealthState::Infected)
+            InfectedCounts.Add(cell, +1);
+    }
+
+    if (lazyPopulation)
+        Population.Clear();
+
+    // Scheduled infections and recoveries are redrawn by the aggregate engine,
+    //   and recovery times are memoryless, so pending events are dropped
+    eq->Clear();
+    recoveries->Clear();
+}
+
+SIR_TEMPLATE
+void SIR_CLASS::CountsToPopulation(DayT t)
+{
+    // The leaps accounted for their own infectious person-time
+    ResetFOIAccount(t);
+    foiExcess = 0;
+
+    // With a lazy population, susceptibles stay in 'SusceptibleCounts' and
+    //   only the infectives are materialized
+    if (lazyPopulation) {
+        for (AgeSexCounts::CellT c = 0; c < InfectedCounts.NumCells(); c++)
+            for (AgeSexCounts::CountT k = 0; k < InfectedCounts.Get(c); k++) {
+                PeopleT i = Population.PushBack(CellIndividual(c, HealthState::Infected));
+                stats.peopleCreated++;
+
+                ScheduleRecovery(t + timeToRecovery(t), i);
+            }
+
+        Schedule(t, SIREvent::Kind::FOIUpdate, 0);
+        return;
+    }
+
+    // People within an age and sex cell are exchangeable, so the first
+    //   members of each cell are made susceptible, the next infected, and the
+    //   rest recovered
+    vector<AgeSexCounts::CountT> nS(SusceptibleCounts.NumCells());
+    vector<AgeSexCounts::CountT> nI(InfectedCounts.NumCells());
+
+    for (AgeSexCounts::CellT c = 0; c < SusceptibleCounts.NumCells(); c++) {
+        nS[c] = SusceptibleCounts.Get(c);
+        nI[c] = InfectedCounts.Get(c);
+    }
+
+    SusceptibleIdx.clear();
+
+    for (PeopleT i = 0; i < Population.Size(); i++) {
+        auto cell = SusceptibleCounts.Cell(sexN(Population.GetSex(i)), Population.GetAge(i));
+
+        if (nS[cell] > 0) {
+            nS[cell] -= 1;
+            Population.SetHealthState(i, HealthState::Susceptible);
+            SusceptiblePos[i] = SusceptibleIdx.size();
+            SusceptibleIdx.push_back(i);
+        } else if (nI[cell] > 0) {
+            nI[cell] -= 1;
+            Population.SetHealthState(i, HealthState::Infected);
+            ScheduleRecovery(t + timeToRecovery(t), i);
+        } else
+            Population.SetHealthState(i, HealthState::Recovered);
+    }
+
+    Schedule(t, SIREvent::Kind::FOIUpdate, 0);
+}
+
+SIR_TEMPLATE
+void SIR_CLASS::RunHybrid(void)
+{
+    DayT t = 0;
+
+    InitPopulation();
+
+    // Alternate between the engines until one of them finishes the run
+    while (AdvanceIndividual(t, hybridToAggregate)) {
+        stats.handOvers.push_back(HandOver{t, nInfected, true});
+        PopulationToCounts();
+        SettleFOIAccount(t);
+
+        if (!AdvanceTauLeaping(t, hybridToIndividual))
             break;
 
-        // Remove event from the queue
+        stats.handOvers.push_back(HandOver{t, nInfected, false});
+
+        CountsToPopulation(t);
+    }
+}
+
+SIR_TEMPLATE
+void SIR_CLASS::RunParallel(void)
+{
+    // The partitions index every susceptible by position
+    if (lazyPopulation)
+        throw out_of_range("lazyPopulation with RunMode::Parallel");
+
+    InitPopulation();
+
+    // Split the population into partitions of contiguous people, each with
+    //   its own RNG seeded from a single draw of 'rng'
+    uint64_t seed = rng->mt_();
+    vector<Partition> partitions(nPartitions);
+
+    for (uint k = 0; k < nPartitions; k++) {
+        Partition &p = partitions[k];
+
+        p.begin      = (PeopleT)((uint64_t)nPeople * k / nPartitions);
+        p.end        = (PeopleT)((uint64_t)nPeople * (k + 1) / nPartitions);
+        p.eq.reset(new EQ{tMax});
+        p.recoveries.reset(new RecoveryStore{tMax});
+        p.rng.reset(new RNG(ChunkSeed(seed, k)));
+        p.foiDraws   = 0;
+
+        p.susceptiblePos.resize(p.end - p.begin);
+        for (PeopleT i = p.begin; i < p.end; i++) {
+            p.susceptiblePos[i - p.begin] = p.susceptibleIdx.size();
+            p.susceptibleIdx.push_back(i);
+        }
+    }
+
+    // The partitions keep their own indices of susceptibles
+    vector<PeopleT>().swap(SusceptibleIdx);
+    vector<PeopleT>().swap(SusceptiblePos);
+
+    // Hand the first infection to the partition of the person infected. The
+    //   first FOI update is kept in 'nextFOIUpdate'.
+    while (!eq->Empty()) {
+        SIREvent e = eq->Top();
         eq->Pop();
+
+        if (e.kind == SIREvent::Kind::Infection)
+            for (auto &p : partitions)
+                if (e.idx >= p.begin && e.idx < p.end)
+                    p.eq->Schedule(e);
     }
 
-    // Calculate the percent of age groups that were infected
-    CalculateInfectionAgePercent();
+    // Run each step up to the next FOI update in parallel, then record its
+    //   transitions and draw the infections of the following step. The
+    //   first step, before the first update, only holds the first infection.
+    DayT tStep = 0;
+    bool update = false;
+
+    while (true) {
+        double foi = 0;
+        if (update) {
+            nextFOIUpdate = tStep + NextFOIStep(tStep);
+            foi           = forceOfInfection(tStep);
+        }
 
-    // Close data structures
-    Susceptible->Close();
-    Infected->Close();
-    Recovered->Close();
-    Infections->Close();
-    Recoveries->Close();
+        DayT tEnd = min(nextFOIUpdate, tMax);
 
-    SusceptiblePyr->Close();
-    InfectedPyr->Close();
-    RecoveredPyr->Close();
-    InfectionsPyr->Close();
-    RecoveriesPyr->Close();
+        partitionPool->ParallelFor(nPartitions, [&] (uint k) {
+            if (update)
+                PartitionFOIUpdate(partitions[k], tStep, foi);
+            PartitionAdvance(partitions[k], tEnd);
+        });
 
-    return true;
+        RecordTransitions(partitions);
+
+        if (nInfected == 0 || tEnd >= tMax)
+            break;
+
+        tStep  = nextFOIUpdate;
+        update = true;
+    }
+
+    for (auto &p : partitions)
+        stats.foiDraws += p.foiDraws;
 }
 
-// Specialization for TimeSeries
-template <>
-TS *SIRSimulation::GetData<TS>(SIRData field)
+SIR_TEMPLATE
+void SIR_CLASS::PartitionFOIUpdate(Partition &p, DayT t, double foi)
 {
-    switch(field) {
-        case SIRData::Susceptible: return Susceptible;
-        case SIRData::Infected:    return Infected;
-        case SIRData::Recovered:   return Recovered;
-        case SIRData::Infections:  return Infections;
-        case SIRData::Recoveries:  return Recoveries;
-        default:                   return nullptr;
+    StatisticalDistributions::Uniform unit(0, 1);
+    PeopleT nSusceptible = p.susceptibleIdx.size();
+
+    if (foiMode == FOIMode::PerIndividual) {
+        SweepSusceptibles(t, foi, p.susceptibleIdx.data(), nSusceptible,
+                          *p.rng, unit, p.newInfections);
+        p.foiDraws += nSusceptible;
+    } else {
+        ThinSusceptibles(t, foi, p.susceptibleIdx, p.susceptiblePos, p.begin,
+                         *p.rng, unit, p.newInfections);
+        p.foiDraws += p.newInfections.size();
     }
+
+    p.eq->ScheduleBulk(p.newInfections.data(), p.newInfections.size());
+    p.newInfections.clear();
 }
 
-template <>
-PrevalenceTimeSeries<int> *SIRSimulation::GetData<PrevalenceTimeSeries<int>>(SIRData field)
+SIR_TEMPLATE
+void SIR_CLASS::PartitionAdvance(Partition &p, DayT tEnd)
 {
-    switch(field) {
-        case SIRData::Susceptible: return Susceptible;
-        case SIRData::Infected:    return Infected;
-        case SIRData::Recovered:   return Recovered;
-        default:                   return nullptr;
+    StatisticalDistributions::Exponential timeToRecovery(1/gamma);
+
+    while (true) {
+        bool hasEvent    = !p.eq->Empty() && p.eq->Top().t < tEnd;
+        bool hasRecovery = !p.recoveries->Empty() && p.recoveries->Top().t < tEnd;
+
+        if (!hasEvent && !hasRecovery)
+            break;
+
+        if (hasRecovery && (!hasEvent || p.recoveries->Top().t < p.eq->Top().t)) {
+            Recovery r = p.recoveries->Top();
+            p.recoveries->Pop();
+
+            Population.SetHealthState(r.idx, HealthState::Recovered);
+            p.transitions.push_back(Transition{r.t, r.idx, true});
+        } else {
+            SIREvent e = p.eq->Top();
+            p.eq->Pop();
+
+            // A person can only be infected once
+            if (Population.GetHealthState(e.idx) != HealthState::Susceptible)
+                continue;
+
+            // Infect the person, dropping them from the partition's index of
+            //   susceptibles, and schedule their recovery
+            RemoveFromIndex(p.susceptibleIdx, p.susceptiblePos, p.begin, e.idx);
+            Population.SetHealthState(e.idx, HealthState::Infected);
+
+            p.recoveries->Schedule(Recovery{e.t + (DayT)timeToRecovery.Sample(*p.rng),
+                                            e.idx});
+            p.transitions.push_back(Transition{e.t, e.idx, false});
+        }
+    }
+}
+
+SIR_TEMPLATE
+void SIR_CLASS::RecordTransitions(vector<Partition> &partitions)
+{
+    // Merge the logs of the partitions, each in order of time, with a heap
+    //   of the first unrecorded transition of each
+    using Head = pair<DayT, uint>;
+    priority_queue<Head, vector<Head>, greater<Head>> heads;
+    vector<size_t> next(partitions.size(), 0);
+
+    for (uint k = 0; k < partitions.size(); k++)
+        if (!partitions[k].transitions.empty())
+            heads.push(Head{partitions[k].transitions[0].t, k});
+
+    while (!heads.empty()) {
+        uint k = heads.top().second;
+        heads.pop();
+
+        auto &log = partitions[k].transitions;
+        Transition tr = log[next[k]++];
+        Individual idv = Population.Get(tr.idx);
+
+        if (tr.recovery) {
+            IdvIncrement<SIRData::Infected>(tr.t, idv, -1);
+            IdvIncrement<SIRData::Recovered>(tr.t, idv, +1);
+            IdvIncrement<SIRData::Recoveries>(tr.t, idv, +1);
+        } else {
+            IdvIncrement<SIRData::Susceptible>(tr.t, idv, -1);
+            IdvIncrement<SIRData::Infected>(tr.t, idv, +1);
+            IdvIncrement<SIRData::Infections>(tr.t, idv, +1);
+        }
+
+        // As in the serial engine, the run ends at the recovery of the last
+        //   infective, so any transitions after it never happened
+        if (nInfected == 0)
+            break;
+
+        if (next[k] < log.size())
+            heads.push(Head{log[next[k]].t, k});
+    }
+
+    for (auto &p : partitions)
+        p.transitions.clear();
+}
+
+SIR_TEMPLATE
+void SIR_CLASS::InitCounts(void)
+{
+    if (lazyPopulation) {
+
+        // Every cell is equally likely, so the counts are multinomial. Draw
+        //   them one cell at a time, each conditional on the people left.
+        AgeSexCounts::CountT remaining = nPeople;
+        AgeSexCounts::CellT  nCells    = SusceptibleCounts.NumCells();
+
+        for (AgeSexCounts::CellT c = 0; c < nCells && remaining > 0; c++) {
+            AgeSexCounts::CountT n = remaining;
+
+            if (c < nCells - 1)
+                n = (AgeSexCounts::CountT)StatisticalDistributions::Binomial( \
+                      remaining, 1.0 / (nCells - c)).Sample(*rng);
+
+            SusceptibleCounts.Add(c, n);
+            remaining -= n;
+
+            // Add people to total age count
+            recorder->RecordTotalAge(SusceptibleCounts.CellAge(c), (int)n);
+        }
+
+    } else {
+
+        // Draw the age and sex of each of the 'nPeople' susceptibles into the
+        //   aggregate counts
+        for (PeopleT i = 0; i < nPeople; i++) {
+
+            auto idv = newIndividual(rng, ageDist, sexDist, HealthState::Susceptible);
+
+            SusceptibleCounts.Add(SusceptibleCounts.Cell(sexN(idv.sex), idv.age), +1);
+
+            // Add person to total age count
+            recorder->RecordTotalAge(idv.age, +1);
+        }
     }
+
+    // Record the susceptibles in bulk, one increment per cell
+    for (AgeSexCounts::CellT c = 0; c < SusceptibleCounts.NumCells(); c++)
+        if (SusceptibleCounts.Get(c) > 0)
+            IdvIncrement<SIRData::Susceptible>(0,
+                         CellIndividual(c, HealthState::Susceptible),
+                         (int)SusceptibleCounts.Get(c));
+}
+
+SIR_TEMPLATE
+Individual SIR_CLASS::CellIndividual(AgeSexCounts::CellT cell, HealthState hs)
+{
+    Individual idv;
+
+    idv.age = (Age)SusceptibleCounts.CellAge(cell);
+    idv.sex = Nsex(SusceptibleCounts.CellSex(cell));
+    idv.hs  = hs;
+
+    return idv;
 }
 
-template <>
-IncidenceTimeSeries<int> *SIRSimulation::GetData<IncidenceTimeSeries<int>>(SIRData field)
+SIR_TEMPLATE
+void SIR_CLASS::AggregateInfection(DayT t)
 {
-    switch(field) {
-        case SIRData::Infections:  return Infections;
-        case SIRData::Recoveries:  return Recoveries;
-        default:                   return nullptr;
+    auto cell = SusceptibleCounts.Sample(unitDist->Sample(*rng));
+    auto idv  = CellIndividual(cell, HealthState::Susceptible);
+
+    SusceptibleCounts.Add(cell, -1);
+    InfectedCounts.Add(cell, +1);
+
+    IdvIncrement<SIRData::Susceptible>(t, idv, -1);
+    IdvIncrement<SIRData::Infected>(t, idv, +1);
+    IdvIncrement<SIRData::Infections>(t, idv, +1);
+}
+
+SIR_TEMPLATE
+void SIR_CLASS::AggregateRecovery(DayT t)
+{
+    auto cell = InfectedCounts.Sample(unitDist->Sample(*rng));
+    auto idv  = CellIndividual(cell, HealthState::Infected);
+
+    InfectedCounts.Add(cell, -1);
+
+    IdvIncrement<SIRData::Infected>(t, idv, -1);
+    IdvIncrement<SIRData::Recovered>(t, idv, +1);
+    IdvIncrement<SIRData::Recoveries>(t, idv, +1);
+}
+
+SIR_TEMPLATE
+bool SIR_CLASS::GillespieStep(DayT &t)
+{
+    double nS = (double)SusceptibleCounts.Total();
+    double nI = (double)InfectedCounts.Total();
+
+    if (nI == 0)
+        return false;
+
+    // Total rates of infection and of recovery
+    double infectionRate = FOIPolicy::ForceOfInfection(lambda, nI, nPeople) * nS;
+    double recoveryRate  = nI / gamma;
+    double totalRate     = infectionRate + recoveryRate;
+
+    // Time to the next event is exponential in the total rate
+    DayT tNext = t - log(1 - (DayT)unitDist->Sample(*rng)) / totalRate;
+
+    // Stop if reached 'tMax'
+    if (tNext >= tMax)
+        return false;
+
+    t = tNext;
+    stats.gillespieSteps++;
+
+    // Choose which kind of event occurs in proportion to its rate
+    if (unitDist->Sample(*rng) * totalRate < infectionRate)
+        AggregateInfection(t);
+    else
+        AggregateRecovery(t);
+
+    return true;
+}
+
+SIR_TEMPLATE
+void SIR_CLASS::RunGillespie(void)
+{
+    InitCounts();
+
+    // As in the individual engine, the first infection occurs at t=0
+    DayT t = 0;
+    AggregateInfection(t);
+
+    // While there are infectives left and 'tMax' has not been reached
+    while (GillespieStep(t))
+        ;
+}
+
+SIR_TEMPLATE
+typename SIR_CLASS::DayT SIR_CLASS::TauLeapSize(void)
+{
+    double nS = (double)SusceptibleCounts.Total();
+    double nI = (double)InfectedCounts.Total();
+
+    double infectionRate = FOIPolicy::ForceOfInfection(lambda, nI, nPeople) * nS;
+    double recoveryRate  = nI / gamma;
+
+    // Expected change and variance of change per unit time of S and I
+    double muS     = -infectionRate;
+    double sigma2S = infectionRate;
+    double muI     = infectionRate - recoveryRate;
+    double sigma2I = infectionRate + recoveryRate;
+
+    // Allowed change in each compartment (Cao, Gillespie & Petzold, 2006).
+    //   Infection is second order, hence the factor of 1/2.
+    double boundS = max(tauLeapEpsilon * nS / 2, 1.0);
+    double boundI = max(tauLeapEpsilon * nI / 2, 1.0);
+
+    DayT tau = deltaT;
+
+    if (muS != 0)
+        tau = min(tau, boundS / fabs(muS));
+    if (sigma2S != 0)
+        tau = min(tau, boundS * boundS / sigma2S);
+    if (muI != 0)
+        tau = min(tau, boundI / fabs(muI));
+    if (sigma2I != 0)
+        tau = min(tau, boundI * boundI / sigma2I);
+
+    // The bounds above limit the net change in I, which vanishes near the
+    //   peak, where infections and recoveries cancel. The force of infection
+    //   is held for the whole leap (see TauLeap), so the turnover of I is
+    //   bounded as well: the expected infections and the expected recoveries
+    //   in a leap are each at most 'tauLeapEpsilon' * I, which keeps a leap
+    //   within 'tauLeapEpsilon' * gamma.
+    double boundTurnover = max(tauLeapEpsilon * nI, 1.0);
+
+    if (infectionRate != 0)
+        tau = min(tau, boundTurnover / infectionRate);
+    if (recoveryRate != 0)
+        tau = min(tau, boundTurnover / recoveryRate);
+
+    return tau;
+}
+
+SIR_TEMPLATE
+void SIR_CLASS::TauLeap(DayT t, DayT tau)
+{
+    double nI = (double)InfectedCounts.Total();
+
+    // Probability that an infective recovers during the leap
+    double pRecovery = 1 - exp(-tau / gamma);
+
+    // Probability that a susceptible is infected during the leap. The force
+    //   of infection is held for the whole leap at its value for the mean
+    //   number of the infectives at its start who have not yet recovered.
+    //   Holding it at its value for all of them would let each infective
+    //   transmit on to the end of the leap in which they recover, raising R0
+    //   by about tau / (2 * gamma).
+    double nIMean     = nI * pRecovery * gamma / tau;
+    double pInfection = 1 - exp(-FOIPolicy::ForceOfInfection(lambda, nIMean, nPeople) * tau);
+
+    for (AgeSexCounts::CellT c = 0; c < SusceptibleCounts.NumCells(); c++) {
+        long nSc = SusceptibleCounts.Get(c);
+        long nIc = InfectedCounts.Get(c);
+        long nInfections = 0;
+        long nRecoveries = 0;
+
+        if (nSc > 0 && pInfection > 0)
+            nInfections = (long)StatisticalDistributions::Binomial(nSc, pInfection) \
+                            .Sample(*rng);
+        if (nIc > 0)
+            nRecoveries = (long)StatisticalDistributions::Binomial(nIc, pRecovery) \
+                            .Sample(*rng);
+
+        if (nInfections == 0 && nRecoveries == 0)
+            continue;
+
+        if (nInfections > 0)
+            InfectCell(t, c, nInfections);
+
+        if (nRecoveries > 0) {
+            auto idv = CellIndividual(c, HealthState::Infected);
+
+            InfectedCounts.Add(c, -nRecoveries);
+            IdvIncrement<SIRData::Infected>(t,   idv, (int)-nRecoveries);
+            IdvIncrement<SIRData::Recovered>(t,  idv, (int)+nRecoveries);
+            IdvIncrement<SIRData::Recoveries>(t, idv, (int)+nRecoveries);
+        }
     }
 }
 
-// Specialization for TimeStatistics
-template <>
-TSx *SIRSimulation::GetData<TSx>(SIRData field)
+SIR_TEMPLATE
+void SIR_CLASS::InfectCell(DayT t, AgeSexCounts::CellT c, long n)
 {
-    switch(field) {
-        case SIRData::Susceptible: return SusceptibleSx;
-        case SIRData::Infected:    return InfectedSx;
-        case SIRData::Recovered:   return RecoveredSx;
-        case SIRData::Infections:  return InfectionsSx;
-        case SIRData::Recoveries:  return RecoveriesSx;
-        default:                   return nullptr;
+    auto idv = CellIndividual(c, HealthState::Susceptible);
+
+    SusceptibleCounts.Add(c, -n);
+    InfectedCounts.Add(c, +n);
+
+    IdvIncrement<SIRData::Susceptible>(t, idv, (int)-n);
+    IdvIncrement<SIRData::Infected>(t,    idv, (int)+n);
+    IdvIncrement<SIRData::Infections>(t,  idv, (int)+n);
+}
+
+SIR_TEMPLATE
+void SIR_CLASS::SettleFOIAccount(DayT t)
+{
+    // Infectious person-time since the last FOI update that was not charged
+    //   for. It is owed by the people infected during the last step, who
+    //   did not transmit before the step ended.
+    double owed = infectiveTime + nInfected * (t - infectiveTimeAt) - foiExcess;
+
+    ResetFOIAccount(t);
+    foiExcess = 0;
+
+    if (!adaptiveFOIStep || owed <= 0)
+        return;
+
+    // Expose the susceptibles to it at once
+    double pInfection = 1 - exp(-FOIPolicy::ForceOfInfection(lambda, owed, nPeople));
+
+    for (AgeSexCounts::CellT c = 0; c < SusceptibleCounts.NumCells(); c++) {
+        long nSc = SusceptibleCounts.Get(c);
+
+        if (nSc == 0)
+            continue;
+
+        long nInfections = (long)StatisticalDistributions::Binomial(nSc, pInfection) \
+                             .Sample(*rng);
+        if (nInfections > 0)
+            InfectCell(t, c, nInfections);
     }
 }
 
-// Specialization for PyramidTimeSeries
-template <>
-PyTS *SIRSimulation::GetData<PyTS>(SIRData field)
+SIR_TEMPLATE
+bool SIR_CLASS::AdvanceTauLeaping(DayT &t, PeopleT stopAt)
 {
-    switch(field) {
-        case SIRData::Susceptible: return SusceptiblePyr;
-        case SIRData::Infected:    return InfectedPyr;
-        case SIRData::Recovered:   return RecoveredPyr;
-        case SIRData::Infections:  return InfectionsPyr;
-        case SIRData::Recoveries:  return RecoveriesPyr;
-        default:                   return nullptr;
+    while (InfectedCounts.Total() > 0 && t < tMax) {
+        double nS = (double)SusceptibleCounts.Total();
+        double nI = (double)InfectedCounts.Total();
+        double infectionRate = FOIPolicy::ForceOfInfection(lambda, nI, nPeople) * nS;
+        double recoveryRate  = nI / gamma;
+        double totalRate     = infectionRate + recoveryRate;
+
+        // Stop if the number of infectives has fallen to 'stopAt'
+        if ((PeopleT)nI <= stopAt)
+            return true;
+
+        DayT tau = min(TauLeapSize(), tMax - t);
+
+        // A leap covering only a few events is no cheaper, and much less
+        //   accurate, than simulating those events exactly
+        if (tau * totalRate < TauLeapMinEvents) {
+            for (int i = 0; i < TauLeapExactSteps; i++) {
+                if (!GillespieStep(t))
+                    return false;
+                if (InfectedCounts.Total() <= (AgeSexCounts::CountT)stopAt)
+                    break;
+            }
+            continue;
+        }
+
+        TauLeap(t, tau);
+        t += tau;
+
+        stats.tauLeaps++;
+        stats.maxLeapChange   = max({stats.maxLeapChange, infectionRate * tau / nS,
+                                     fabs(infectionRate - recoveryRate) * tau / nI});
+        stats.maxLeapTurnover = max({stats.maxLeapTurnover, infectionRate * tau / nI,
+                                     recoveryRate * tau / nI});
     }
+
+    return false;
+}
+
+SIR_TEMPLATE
+void SIR_CLASS::RunTauLeaping(void)
+{
+    InitCounts();
+
+    // As in the individual engine, the first infection occurs at t=0
+    DayT t = 0;
+    AggregateInfection(t);
+
+    AdvanceTauLeaping(t, 0);
 }
 
-// Specialization for PyramidData
-template <>
-PyramidData<double> *SIRSimulation::GetData<PyramidData<double>>(SIRData field)
+SIR_TEMPLATE
+bool SIR_CLASS::Run(void)
 {
-    switch(field) {
-        case SIRData::Susceptible: return nullptr;
-        case SIRData::Infected:    return nullptr;
-        case SIRData::Recovered:   return nullptr;
-        case SIRData::Infections:  return InfectionsAgePercent;
-        case SIRData::Recoveries:  return nullptr;
-        default:                   return nullptr;
+    stats = RunStats();
+
+    switch (runMode) {
+        case RunMode::Individual:
+            RunIndividual();
+            break;
+
+        case RunMode::Gillespie:
+            RunGillespie();
+            break;
+
+        case RunMode::TauLeaping:
+            RunTauLeaping();
+            break;
+
+        case RunMode::Hybrid:
+            RunHybrid();
+            break;
+
+        case RunMode::Parallel:
+            RunParallel();
+            break;
     }
+
+    // Free the events left pending at 'tMax' in bulk
+    eq->Release();
+    recoveries->Release();
+
+    // Calculate the case profile and close data structures
+    recorder->Close();
+
+    return true;
 }
+
+// Instantiate the policy combinations aliased in SIRlib.h
+template class SIRlib::BasicSIRSimulation<FullRecorder, FrequencyDependentFOI, CalendarEventQueue>;
+template class SIRlib::BasicSIRSimulation<InfectionsRecorder, FrequencyDependentFOI, CalendarEventQueue>;
+template class SIRlib::BasicSIRSimulation<FullRecorder, FrequencyDependentFOI, RadixEventQueue>;
+template class SIRlib::BasicSIRSimulation<StreamingRecorder, FrequencyDependentFOI, CalendarEventQueue>;
@@ -0,0 +1,109 @@
+#include <stdexcept>
+
+#include "../include/SIRlib/ThreadPool.h"
+
+using namespace std;
+using namespace SIRlib;
+
+ThreadPool::ThreadPool(unsigned int nThreads)
+{
+    if (nThreads < 1)
+        throw out_of_range("nThreads < 1");
+
+    loop       = nullptr;
+    loopN      = 0;
+    loopActive = 0;
+    generation = 0;
+    pending    = 0;
+    stopping   = false;
+
+    for (unsigned int w = 1; w < nThreads; w++)
+        workers.emplace_back(&ThreadPool::Work, this, w);
+}
+
+ThreadPool::~ThreadPool(void)
+{
+    {
+        lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    started.notify_all();
+
+    for (auto &worker : workers)
+        worker.join();
+}
+
+void ThreadPool::Run(unsigned int n, const Loop &f)
+{
+    unsigned int nActive = n < NumThreads() ? n : NumThreads();
+
+    if (nActive == 0)
+        return;
+
+    // Hand the loop to workers [1, nActive); the rest sit it out
+    {
+        lock_guard<std::mutex> lock(mutex);
+        loop       = &f;
+        loopN      = n;
+        loopActive = nActive;
+        pending    = nActive - 1;
+        error      = nullptr;
+        generation++;
+    }
+    if (nActive > 1)
+        started.notify_all();
+
+    RunShare(f, n, nActive, 0);
+
+    exception_ptr e;
+    {
+        unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this] { return pending == 0; });
+
+        loop = nullptr;
+        e    = error;
+    }
+
+    if (e)
+        rethrow_exception(e);
+}
+
+void ThreadPool::Work(unsigned int w)
+{
+    unsigned long seen = 0;
+
+    while (true) {
+        unique_lock<std::mutex> lock(mutex);
+        started.wait(lock, [&] { return stopping || generation != seen; });
+
+        if (stopping)
+            return;
+
+        seen = generation;
+        if (w >= loopActive)
+            continue;
+
+        const Loop  *f       = loop;
+        unsigned int n       = loopN;
+        unsigned int nActive = loopActive;
+        lock.unlock();
+
+        RunShare(*f, n, nActive, w);
+
+        lock.lock();
+        if (--pending == 0)
+            finished.notify_one();
+    }
+}
+
+void ThreadPool::RunShare(const Loop &f, unsigned int n, unsigned int nActive, unsigned int w)
+{
+    try {
+        for (unsigned int i = w; i < n; i += nActive)
+            f(i);
+    } catch (...) {
+        lock_guard<std::mutex> lock(mutex);
+        if (!error)
+            error = current_exception();
+    }
+}
@@ -0,0 +1,47 @@
+#include "catch.hpp"
+
+#include "../include/SIRlib/AgeSexCounts.h"
+
+using namespace std;
+using namespace SIRlib;
+
+TEST_CASE("Cells round-trip age and sex", "[AgeSexCounts]") {
+    AgeSexCounts counts(5, 20);
+
+    REQUIRE(counts.NumCells() == 32);
+
+    for (int sex = 0; sex < 2; sex++)
+        for (unsigned int age = 5; age <= 20; age++) {
+            auto c = counts.Cell(sex, age);
+            REQUIRE(counts.CellSex(c) == sex);
+            REQUIRE(counts.CellAge(c) == age);
+        }
+}
+
+TEST_CASE("Sampling visits every person in cell order", "[AgeSexCounts]") {
+    AgeSexCounts counts(0, 9);
+
+    counts.Add(counts.Cell(0, 3), 2);
+    counts.Add(counts.Cell(1, 0), 1);
+    counts.Add(counts.Cell(1, 9), 3);
+    counts.Add(counts.Cell(0, 3), -1);
+
+    REQUIRE(counts.Total() == 5);
+
+    // Person k of 5 is drawn for u in [k/5, (k+1)/5)
+    REQUIRE(counts.Sample(0.0) == counts.Cell(0, 3));
+    REQUIRE(counts.Sample(0.1) == counts.Cell(0, 3));
+    REQUIRE(counts.Sample(0.2) == counts.Cell(1, 0));
+    REQUIRE(counts.Sample(0.4) == counts.Cell(1, 9));
+    REQUIRE(counts.Sample(0.999) == counts.Cell(1, 9));
+}
+
+TEST_CASE("Clear empties every cell", "[AgeSexCounts]") {
+    AgeSexCounts counts(0, 9);
+
+    counts.Add(counts.Cell(1, 4), 7);
+    counts.Clear();
+
+    REQUIRE(counts.Total() == 0);
+    REQUIRE(counts.Get(counts.Cell(1, 4)) == 0);
+}
@@ -0,0 +1,245 @@
+#include "catch.hpp"
+
+#include <random>
+
+#include "../include/SIRlib/EventQueues.h"
+
+using namespace std;
+using namespace SIRlib;
+
+TEST_CASE("Heap queue returns events in order of time", "[EventQueues]") {
+    HeapEventQueue eq;
+    mt19937 mt(1);
+    uniform_real_distribution<double> u(0, 100);
+
+    for (uint32_t i = 0; i < 1000; i++)
+        eq.Schedule(SIREvent{u(mt), i, SIREvent::Kind::Infection});
+
+    REQUIRE(eq.Size() == 1000);
+
+    double last = -1;
+    while (!eq.Empty()) {
+        REQUIRE(eq.Top().t >= last);
+        last = eq.Top().t;
+        eq.Pop();
+    }
+}
+
+TEST_CASE("Heap queue keeps the payload of each event", "[EventQueues]") {
+    HeapEventQueue eq;
+
+    eq.Schedule(SIREvent{2.5, 7, SIREvent::Kind::Infection});
+    eq.Schedule(SIREvent{0.5, 3, SIREvent::Kind::Infection});
+    eq.Schedule(SIREvent{1.0, 0, SIREvent::Kind::FOIUpdate});
+
+    REQUIRE(eq.Top().idx == 3);
+    REQUIRE(eq.Top().kind == SIREvent::Kind::Infection);
+    eq.Pop();
+    REQUIRE(eq.Top().kind == SIREvent::Kind::FOIUpdate);
+    eq.Pop();
+    REQUIRE(eq.Top().idx == 7);
+    REQUIRE(eq.Top().kind == SIREvent::Kind::Infection);
+
+    eq.Clear();
+    REQUIRE(eq.Empty());
+}
+
+TEST_CASE("Calendar queue returns events in order of time", "[EventQueues]") {
+    CalendarEventQueue eq(50);
+    mt19937 mt(1);
+    uniform_real_distribution<double> u(0, 100);
+
+    // Half of the events fall after 'tMax', in the last bucket
+    for (uint32_t i = 0; i < 1000; i++)
+        eq.Schedule(SIREvent{u(mt), i, SIREvent::Kind::Infection});
+
+    REQUIRE(eq.Size() == 1000);
+
+    // Schedule more events while draining, some within the current day
+    double last = -1;
+    int n = 0;
+    while (!eq.Empty()) {
+        REQUIRE(eq.Top().t >= last);
+        last = eq.Top().t;
+        eq.Pop();
+
+        if (n++ < 500)
+            eq.Schedule(SIREvent{last + u(mt) / 50, 0, SIREvent::Kind::Infection});
+    }
+
+    REQUIRE(n == 1500);
+}
+
+TEST_CASE("Calendar queue can be reused after Clear", "[EventQueues]") {
+    CalendarEventQueue eq(10);
+
+    eq.Schedule(SIREvent{5.5, 1, SIREvent::Kind::Infection});
+    eq.Schedule(SIREvent{2.5, 2, SIREvent::Kind::Infection});
+    REQUIRE(eq.Top().idx == 2);
+    eq.Pop();
+
+    eq.Clear();
+    REQUIRE(eq.Empty());
+
+    eq.Schedule(SIREvent{3.0, 3, SIREvent::Kind::Infection});
+    eq.Schedule(SIREvent{0.5, 4, SIREvent::Kind::FOIUpdate});
+    REQUIRE(eq.Top().idx == 4);
+    eq.Pop();
+    REQUIRE(eq.Top().idx == 3);
+    eq.Pop();
+    REQUIRE(eq.Empty());
+}
+
+TEST_CASE("Arena recycles released blocks", "[EventQueues]") {
+    EventArena arena;
+
+    EventArena::Block *a = arena.Allocate();
+    EventArena::Block *b = arena.Allocate();
+    REQUIRE(a != b);
+
+    arena.Release(a);
+    REQUIRE(arena.Allocate() == a);
+
+    // After a reset, blocks are carved from the start of the slabs again
+    arena.Reset();
+    REQUIRE(arena.Allocate() == a);
+    REQUIRE(arena.Allocate() == b);
+}
+
+TEST_CASE("Bulk scheduling keeps both queues in order", "[EventQueues]") {
+    HeapEventQueue     heap;
+    CalendarEventQueue calendar(50);
+    mt19937 mt(2);
+    uniform_real_distribution<double> u(0, 1);
+
+    // Alternate bulk and single schedules, in batches small and large
+    // relative to the queue, falling both in and after the current day
+    double now = 0;
+    for (int step = 0; step < 40; step++) {
+        vector<SIREvent> batch;
+        for (int i = 0; i < (step % 2 ? 5 : 300); i++)
+            batch.push_back(SIREvent{now + 3 * u(mt), (uint32_t)i, SIREvent::Kind::Infection});
+
+        heap.ScheduleBulk(batch.data(), batch.size());
+        calendar.ScheduleBulk(batch.data(), batch.size());
+        heap.Schedule(SIREvent{now + 1, 0, SIREvent::Kind::FOIUpdate});
+        calendar.Schedule(SIREvent{now + 1, 0, SIREvent::Kind::FOIUpdate});
+
+        // Drain the events before 'now + 1'
+        while (heap.Top().t < now + 1) {
+            REQUIRE(calendar.Top().t == heap.Top().t);
+            REQUIRE(heap.Top().t >= now);
+            heap.Pop();
+            calendar.Pop();
+        }
+        now += 1;
+    }
+
+    REQUIRE(heap.Size() == calendar.Size());
+}
+
+TEST_CASE("Recovery store returns recoveries in order of time", "[EventQueues]") {
+    RecoveryStore recoveries(100);
+    mt19937 mt(3);
+    exponential_distribution<double> ttR(0.2);
+
+    REQUIRE(sizeof(Recovery) == 12);
+
+    // Each recovery schedules another, as infections do in the simulation
+    for (uint32_t i = 0; i < 100; i++)
+        recoveries.Schedule(Recovery{ttR(mt), i});
+
+    double last = -1;
+    while (!recoveries.Empty()) {
+        Recovery r = recoveries.Top();
+        recoveries.Pop();
+
+        REQUIRE(r.t >= last);
+        last = r.t;
+
+        if (r.t < 100)
+            recoveries.Schedule(Recovery{r.t + ttR(mt), r.idx});
+    }
+}
+
+TEST_CASE("Radix queue returns events in order of tick", "[EventQueues]") {
+    RadixEventQueue eq;
+    mt19937 mt(4);
+    uniform_real_distribution<double> u(0, 100);
+
+    for (uint32_t i = 0; i < 1000; i++)
+        eq.Schedule(SIREvent{u(mt), i, SIREvent::Kind::Infection});
+
+    double last = -1;
+    int n = 0;
+    while (!eq.Empty()) {
+        REQUIRE(eq.Top().t >= last);
+        last = eq.Top().t;
+        eq.Pop();
+
+        if (n++ < 500)
+            eq.Schedule(SIREvent{last + u(mt) / 50, 0, SIREvent::Kind::Infection});
+    }
+
+    REQUIRE(n == 1500);
+}
+
+TEST_CASE("Radix queue rounds times to ticks", "[EventQueues]") {
+    RadixEventQueue eq;
+
+    // Sums that miss each other by a rounding error land on one tick
+    eq.Schedule(SIREvent{0.1 + 0.2, 1, SIREvent::Kind::Infection});
+    eq.Schedule(SIREvent{0.3, 2, SIREvent::Kind::Infection});
+
+    double t = eq.Top().t;
+    eq.Pop();
+    REQUIRE(eq.Top().t == t);
+    REQUIRE(RadixEventQueue::ToTicks(t) == 300000);
+}
+
+TEST_CASE("Radix queue pops the events of a tick in order of kind", "[EventQueues]") {
+    RadixEventQueue eq;
+
+    // Kinds interleaved on one tick, at times missing it by rounding errors,
+    //   after an earlier event, so that they are moved down from a higher
+    //   bucket when it is popped
+    eq.Schedule(SIREvent{0.5, 0, SIREvent::Kind::Infection});
+    for (uint32_t i = 1; i <= 20; i++) {
+        auto kind = i % 2 ? SIREvent::Kind::FOIUpdate : SIREvent::Kind::Infection;
+        eq.Schedule(SIREvent{0.1 * i + (3 - 0.1 * i), i, kind});
+    }
+
+    eq.Pop();
+    for (int i = 0; i < 20; i++) {
+        REQUIRE(RadixEventQueue::ToTicks(eq.Top().t) == 3000000);
+        REQUIRE(eq.Top().kind == (i < 10 ? SIREvent::Kind::Infection
+                                         : SIREvent::Kind::FOIUpdate));
+        eq.Pop();
+    }
+    REQUIRE(eq.Empty());
+}
+
+// Infections on the tick of the next FOI update, scheduled before it as
+//   FOIUpdateEvent does
+template <typename Queue>
+static void CheckInfectionBeforeFOIUpdate(void) {
+    Queue eq(100);
+
+    eq.Schedule(SIREvent{1.001 - 0.3e-6, 7, SIREvent::Kind::Infection});
+    eq.Schedule(SIREvent{1.001, 8, SIREvent::Kind::Infection});
+    eq.Schedule(SIREvent{1.001, 0, SIREvent::Kind::FOIUpdate});
+
+    REQUIRE(eq.Top().kind == SIREvent::Kind::Infection);
+    eq.Pop();
+    REQUIRE(eq.Top().kind == SIREvent::Kind::Infection);
+    eq.Pop();
+    REQUIRE(eq.Top().kind == SIREvent::Kind::FOIUpdate);
+    eq.Pop();
+    REQUIRE(eq.Empty());
+}
+
+TEST_CASE("Infections pop before an FOI update at the same time", "[EventQueues]") {
+    CheckInfectionBeforeFOIUpdate<HeapEventQueue>();
+    CheckInfectionBeforeFOIUpdate<CalendarEventQueue>();
+    CheckInfectionBeforeFOIUpdate<RadixEventQueue>();
+}
@@ -0,0 +1,54 @@
+#include "catch.hpp"
+
+#include <cmath>
+#include <vector>
+
+#include "../include/SIRlib/ExpKernel.h"
+
+using namespace std;
+using namespace SIRlib;
+
+// Runs the kernel for instruction set 'level' on a spread of uniforms,
+//   including the endpoints and an odd length to exercise the scalar tail,
+//   and compares against -log(u)/rate
+static void checkKernel(SIMDLevel level) {
+    double rate = 0.37;
+    vector<double> u, out;
+
+    u.push_back(1.0);
+    u.push_back(0.5);
+    u.push_back(1e-300);
+    u.push_back(nextafter(1.0, 0.0));
+    for (int i = 1; i < 1000; i++)
+        u.push_back(i / 1000.0);
+    out.resize(u.size());
+
+    ExponentialFromUniforms(level, u.data(), out.data(), u.size(), rate);
+
+    for (size_t i = 0; i < u.size(); i++)
+        REQUIRE(out[i] == Approx(-log(u[i]) / rate).epsilon(1e-12).margin(1e-15));
+}
+
+TEST_CASE("Scalar exponential kernel", "[ExpKernel]") {
+    checkKernel(SIMDLevel::Scalar);
+}
+
+TEST_CASE("Vector exponential kernels match scalar", "[ExpKernel]") {
+    SIMDLevel supported = DetectSIMDLevel();
+
+    if (supported >= SIMDLevel::SSE2)
+        checkKernel(SIMDLevel::SSE2);
+    if (supported >= SIMDLevel::AVX2)
+        checkKernel(SIMDLevel::AVX2);
+
+    REQUIRE(true);
+}
+
+TEST_CASE("In-place transformation", "[ExpKernel]") {
+    vector<double> u {0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7, 0.8, 0.9};
+
+    ExponentialFromUniforms(u.data(), u.data(), u.size(), 2.0);
+
+    REQUIRE(u[0] == Approx(-log(0.1) / 2.0));
+    REQUIRE(u[8] == Approx(-log(0.9) / 2.0));
+}
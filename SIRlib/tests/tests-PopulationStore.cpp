@@ -0,0 +1,33 @@
+#include "catch.hpp"
+
+#include "../include/SIRlib/PopulationStore.h"
+
+using namespace std;
+using namespace SIRlib;
+
+TEST_CASE("Stored attributes are read back unchanged", "[PopulationStore]") {
+    PopulationStore pop;
+
+    // Span more than one word of packed sexes
+    for (unsigned int i = 0; i < 200; i++) {
+        Individual idv;
+        idv.hs  = HealthState::Susceptible;
+        idv.sex = (i % 3 == 0) ? Sex::Female : Sex::Male;
+        idv.age = i % 101;
+
+        REQUIRE(pop.PushBack(idv) == i);
+    }
+
+    pop.SetHealthState(130, HealthState::Infected);
+
+    REQUIRE(pop.Size() == 200);
+    for (unsigned int i = 0; i < 200; i++) {
+        REQUIRE(pop.GetSex(i) == ((i % 3 == 0) ? Sex::Female : Sex::Male));
+        REQUIRE(pop.GetAge(i) == i % 101);
+        REQUIRE(pop.GetHealthState(i) ==
+                (i == 130 ? HealthState::Infected : HealthState::Susceptible));
+    }
+
+    pop.Clear();
+    REQUIRE(pop.Size() == 0);
+}
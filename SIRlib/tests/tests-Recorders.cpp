@@ -0,0 +1,204 @@
+#include "catch.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include "../include/SIRlib/Recorders.h"
+
+using namespace std;
+using namespace SIRlib;
+
+// Age breaks of the pyramids, some of them equal to ages recorded below
+static const vector<double> ageBreaks = {1, 10, 17.5, 40, 254};
+
+// Returns the group of 'age' for the breaks 'breaks'
+static int AgeGroupOf(const vector<double> &breaks, Age age)
+{
+    return (int)(upper_bound(breaks.begin(), breaks.end(), (double)age) - breaks.begin());
+}
+
+// Records at time 0 one infection of weight 'age + 1' at every age in
+//   [0, MaxAge], alternating sex
+template <typename Recorder>
+static void RecordEveryAge(Recorder &recorder)
+{
+    for (Age age = 0; age <= MaxAge; age++)
+        recorder.template Record<SIRData::Infections>(0, age % 2, age, age + 1);
+
+    recorder.Close();
+}
+
+// Sums the weights RecordEveryAge gives the ages of group 'group' and sex
+//   'sex' (or either sex if -1) under 'breaks'
+static int ExpectedInGroup(const vector<double> &breaks, int group, int sex)
+{
+    int total = 0;
+
+    for (Age age = 0; age <= MaxAge; age++)
+        if (AgeGroupOf(breaks, age) == group && (sex < 0 || (int)age % 2 == sex))
+            total += age + 1;
+
+    return total;
+}
+
+// Keeps the changes by sex and age group of the first period
+struct FirstPeriodSink : public PeriodSink {
+    vector<int> byAgeGroup;
+
+    void ClosePeriod(unsigned int period, const int *totals,
+                     const int *periodByAgeGroup, int nAgeGroups) override {
+        if (period == 0)
+            byAgeGroup.assign(periodByAgeGroup,
+                              periodByAgeGroup + StreamingRecorder::nFields
+                                               * StreamingRecorder::nSexes * nAgeGroups);
+    }
+};
+
+TEST_CASE("FullRecorder groups ages as the breaks do", "[Recorders]") {
+    FullRecorder recorder(100, 10, ageBreaks);
+    vector<double> profileBreaks(begin(ProfileAgeBreaks), end(ProfileAgeBreaks));
+
+    RecordEveryAge(recorder);
+
+    REQUIRE(recorder.NumAgeGroups() == (int)ageBreaks.size() + 1);
+    REQUIRE(recorder.NumProfileGroups() == (int)profileBreaks.size() + 1);
+
+    for (int sex = 0; sex < 2; sex++)
+        for (int group = 0; group < recorder.NumAgeGroups(); group++)
+            REQUIRE(recorder.ByAgeGroup(SIRData::Infections, 0, sex, group) ==
+                    ExpectedInGroup(ageBreaks, group, sex));
+
+    for (int group = 0; group < recorder.NumProfileGroups(); group++)
+        REQUIRE(recorder.InfectionsByAgeGroup(group) ==
+                ExpectedInGroup(profileBreaks, group, -1));
+}
+
+TEST_CASE("StreamingRecorder groups ages as the breaks do", "[Recorders]") {
+    StreamingRecorder recorder(100, 10, ageBreaks);
+    vector<double> profileBreaks(begin(ProfileAgeBreaks), end(ProfileAgeBreaks));
+    FirstPeriodSink sink;
+    int nAgeGroups = (int)ageBreaks.size() + 1;
+
+    recorder.SetSink(&sink);
+    RecordEveryAge(recorder);
+
+    REQUIRE(sink.byAgeGroup.size() == (size_t)5 * 2 * nAgeGroups);
+
+    int field = (int)SIRData::Infections;
+    for (int sex = 0; sex < 2; sex++)
+        for (int group = 0; group < nAgeGroups; group++)
+            REQUIRE(sink.byAgeGroup[(field * 2 + sex) * nAgeGroups + group] ==
+                    ExpectedInGroup(ageBreaks, group, sex));
+
+    for (int group = 0; group < (int)profileBreaks.size() + 1; group++)
+        REQUIRE(recorder.InfectionsByAgeGroup(group) ==
+                ExpectedInGroup(profileBreaks, group, -1));
+}
+
+TEST_CASE("FullRecorder builds its datastores only after Close", "[Recorders]") {
+    FullRecorder recorder(100, 10, ageBreaks);
+
+    recorder.Record<SIRData::Infected>(3, 0, 30, +2);
+    recorder.Record<SIRData::Infected>(7, 1, 50, -1);
+    recorder.Record<SIRData::Infected>(12, 0, 30, +4);
+
+    REQUIRE_THROWS(recorder.GetData<TimeSeries<int>>(SIRData::Infected));
+    REQUIRE_THROWS(recorder.GetData<PyramidData<double>>(SIRData::Infections));
+
+    recorder.Close();
+
+    // The series holds the prevalence at the end of each period
+    TimeSeries<int> *infected = recorder.GetData<TimeSeries<int>>(SIRData::Infected);
+
+    REQUIRE(infected != nullptr);
+    REQUIRE(infected->GetTotalAtTime(0) == 1);
+    REQUIRE(infected->GetTotalAtTime(10) == 5);
+    REQUIRE(recorder.Total(SIRData::Infected, 0) == 1);
+    REQUIRE(recorder.Total(SIRData::Infected, 1) == 4);
+}
+
+TEST_CASE("FullRecorder keeps no room for masked fields", "[recorders]") {
+    FullRecorder all(20, 10, ageBreaks);
+    FullRecorder masked(20, 10, ageBreaks,
+                        SIRDataBit(SIRData::Infected) | SIRDataBit(SIRData::Recoveries));
+
+    int nFields = FullRecorder::nFields;
+
+    REQUIRE(all.NumColumns() == nFields);
+    REQUIRE(masked.NumColumns() == 2);
+    REQUIRE(masked.Column(SIRData::Infected) == 0);
+    REQUIRE(masked.Column(SIRData::Recoveries) == 1);
+    REQUIRE(masked.Column(SIRData::Infections) == -1);
+
+    // Everything but the case profile scales with the number of columns
+    size_t nProfile = 2 * (size_t)all.NumProfileGroups();
+    REQUIRE((masked.Size() - nProfile) * nFields ==
+            (all.Size() - nProfile) * 2);
+
+    masked.Record<SIRData::Infected>(3, 0, 30, +2);
+    masked.Record<SIRData::Infections>(3, 0, 30, 1);
+    masked.Record<SIRData::Recoveries>(12, 1, 50, 1);
+    masked.Close();
+
+    REQUIRE(masked.Total(SIRData::Infected, 0) == 2);
+    REQUIRE(masked.Total(SIRData::Recoveries, 1) == 1);
+    REQUIRE(masked.Total(SIRData::Infections, 0) == 0);
+    REQUIRE(masked.ByAgeGroup(SIRData::Infected, 0, 0, AgeGroupOf(ageBreaks, 30)) == 2);
+    REQUIRE(masked.GetData<TimeSeries<int>>(SIRData::Infections) == nullptr);
+    REQUIRE(masked.GetData<TimeSeries<int>>(SIRData::Recoveries)->GetTotal() == 1);
+}
+
+// Keeps the totals of every period
+struct AllPeriodsSink : public PeriodSink {
+    vector<vector<int>> totals;
+
+    void ClosePeriod(unsigned int period, const int *periodTotals,
+                     const int *byAgeGroup, int nAgeGroups) override {
+        totals.emplace_back(periodTotals, periodTotals + StreamingRecorder::nFields);
+    }
+};
+
+TEST_CASE("StreamingRecorder passes counts for prevalence fields", "[Recorders]") {
+    // More periods than slots, so the counts are carried over reused slots
+    StreamingRecorder recorder(100, 10, ageBreaks);
+    AllPeriodsSink sink;
+
+    recorder.SetSink(&sink);
+    recorder.Record<SIRData::Infected>(3, 0, 30, +2);
+    recorder.Record<SIRData::Infections>(3, 0, 30, 2);
+    recorder.Record<SIRData::Infected>(55, 1, 50, -1);
+    recorder.Record<SIRData::Infected>(72, 0, 30, +4);
+    recorder.Record<SIRData::Infections>(72, 0, 30, 4);
+    recorder.Close();
+
+    REQUIRE(sink.totals.size() == 11);
+
+    int infected[11]   = {2, 2, 2, 2, 2, 1, 1, 5, 5, 5, 5};
+    int infections[11] = {2, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0};
+    for (int period = 0; period < 11; period++) {
+        REQUIRE(sink.totals[period][(int)SIRData::Infected] == infected[period]);
+        REQUIRE(sink.totals[period][(int)SIRData::Infections] == infections[period]);
+    }
+}
+
+TEST_CASE("StreamingRecorder keeps the case profiles", "[Recorders]") {
+    StreamingRecorder recorder(100, 10, ageBreaks);
+    vector<double> profileBreaks(begin(ProfileAgeBreaks), end(ProfileAgeBreaks));
+
+    for (Age age = 0; age <= MaxAge; age++)
+        recorder.RecordTotalAge(age, age + 1);
+    recorder.Record<SIRData::Infections>(0, 0, 30, 3);
+    recorder.Record<SIRData::Infections>(0, 1, 2, 1);
+
+    REQUIRE_THROWS(recorder.GetData<PyramidData<double>>(SIRData::Infections));
+    recorder.Close();
+
+    for (int group = 0; group < (int)profileBreaks.size() + 1; group++)
+        REQUIRE(recorder.PopulationByAgeGroup(group) ==
+                ExpectedInGroup(profileBreaks, group, -1));
+
+    PyramidData<double> *percent = recorder.GetData<PyramidData<double>>(SIRData::Infections);
+
+    REQUIRE(percent != nullptr);
+    REQUIRE(recorder.GetData<PyramidData<double>>(SIRData::Infected) == nullptr);
+}
@@ -1,5 +1,7 @@
 #include "catch.hpp"
 
+#include <cmath>
+#include <functional>
 #include <map>
 #include <string>
 
@@ -10,6 +12,66 @@
 using namespace std;
 using namespace SIRlib;
 
+// Number of infections over one run with seed 'seed' of a simulation of
+//   'nPeople' people with R0 = lambda * gamma = 1.5, set up by 'configure'
+template <typename Sim, typename F>
+static int FinalSize(unsigned int seed, unsigned int nPeople, F configure)
+{
+    RNG rng(seed);
+    Sim sir(&rng, 0.3, 5, nPeople, 0, 100, 10, 400, 1, 10);
+
+    configure(sir);
+    sir.Run();
+
+    return sir.template GetData<TimeSeries<int>>(SIRData::Infections)->GetTotal();
+}
+
+// Runs the simulation of FinalSize with seed 'seed', returning the work done
+//   by its engines and setting 'nInfections' to the infections over the run
+template <typename Sim = SIRSimulation, typename F>
+static RunStats StatsOfRun(unsigned int seed, unsigned int nPeople, F configure,
+                           int &nInfections)
+{
+    RNG rng(seed);
+    Sim sir(&rng, 0.3, 5, nPeople, 0, 100, 10, 400, 1, 10);
+
+    configure(sir);
+    sir.Run();
+
+    nInfections = sir.template GetData<TimeSeries<int>>(SIRData::Infections)->GetTotal();
+    return sir.GetRunStats();
+}
+
+// Attack rates of the runs with seeds [1, nRuns] of FinalSize
+struct AttackRate {
+    double mean;  // Mean attack rate of the major outbreaks
+    double major; // Fraction of runs that are major outbreaks
+};
+
+// Returns the attack rates of 'nRuns' runs of FinalSize. A major outbreak
+//   infects more than a tenth of the population.
+template <typename Sim = SIRSimulation, typename F>
+static AttackRate MajorAttackRate(unsigned int nRuns, unsigned int nPeople, F configure)
+{
+    double total  = 0;
+    int    nMajor = 0;
+
+    for (unsigned int seed = 1; seed <= nRuns; seed++) {
+        int n = FinalSize<Sim>(seed, nPeople, configure);
+
+        if (n > (int)nPeople / 10) {
+            total  += (double)n / nPeople;
+            nMajor += 1;
+        }
+    }
+
+    return AttackRate{nMajor > 0 ? total / nMajor : 0, (double)nMajor / nRuns};
+}
+
+// Final size of an SIR epidemic with R0 = 1.5 as a fraction of the
+//   population, the root of z = 1 - exp(-1.5 z)
+static const double TheoreticalAttackRate = 0.5828;
+
 TEST_CASE("Correct parameters, instantiation followed by destruction", "[SIR]") {
     RNG *rng = new RNG(time(NULL));
     SIRSimulation *sir =
@@ -68,6 +130,9 @@ TEST_CASE("Bad parameters", "[SIR]") {
 
     // agebreaks too big
     REQUIRE_THROWS(sir = new SIRSimulation(rng, 1, 1, 10, 0, 10, 11, 365, 1, 7));
+
+    // ages too big to store in one byte
+    REQUIRE_THROWS(sir = new SIRSimulation(rng, 1, 1, 10, 0, 300, 10, 365, 1, 7));
 }
 
 TEST_CASE("Correct parameters, really long duration of infectiousness", "[SIR]") {
@@ -87,3 +152,594 @@ TEST_CASE("Correct parameters, really long duration of infectiousness", "[SIR]")
 
     delete sir;
 }
+
+TEST_CASE("Subcritical outbreaks end after 1 / (1 - R0) infections on average", "[SIR]") {
+    double total = 0;
+
+    // R0 = 0.5. Each run ends at the recovery of the last infective, with
+    //   nobody left infected.
+    for (unsigned int seed = 1; seed <= 400; seed++) {
+        RNG rng(seed);
+        SIRSimulation sir(&rng, 0.1, 5, 10000, 0, 100, 10, 400, 1, 10);
+
+        sir.Run();
+
+        total += sir.GetData<TimeSeries<int>>(SIRData::Infections)->GetTotal();
+        REQUIRE(sir.GetData<TimeSeries<int>>(SIRData::Infected)->GetTotalAtTime(399) == 0);
+    }
+
+    REQUIRE(total / 400 == Approx(1 / (1 - 0.5)).margin(0.25));
+}
+
+// Checks over seeded runs with R0 = 50, where nearly everyone is infected,
+//   that the infections recorded equal the susceptibles lost, which a
+//   person infected a second time would break
+template <typename Sim>
+static void CheckInfectedOnce(FOIMode foiMode)
+{
+    for (unsigned int seed = 1; seed <= 20; seed++) {
+        RNG rng(seed);
+        Sim sir(&rng, 5, 10, 200, 0, 100, 10, 100, 1, 10);
+
+        sir.SetFOIMode(foiMode);
+        sir.Run();
+
+        int nInfections  = sir.template GetData<TimeSeries<int>>(SIRData::Infections)->GetTotal();
+        int nSusceptible = sir.template GetData<TimeSeries<int>>(SIRData::Susceptible)->GetTotalAtTime(99);
+
+        REQUIRE(nSusceptible >= 0);
+        REQUIRE(nInfections == 200 - nSusceptible);
+    }
+}
+
+TEST_CASE("Nobody is infected twice", "[SIR]") {
+    FOIMode foiModes[] = {FOIMode::PerIndividual, FOIMode::Binomial};
+
+    for (auto foiMode : foiModes) {
+        CheckInfectedOnce<SIRSimulation>(foiMode);
+        CheckInfectedOnce<RadixSIRSimulation>(foiMode);
+    }
+}
+
+TEST_CASE("Per-individual FOI sweep final size matches theory", "[SIR]") {
+    auto perIndividual = [] (SIRSimulation &sir) {};
+
+    AttackRate sweep = MajorAttackRate(200, 2000, perIndividual);
+
+    // A major outbreak follows with probability 1 - 1 / R0
+    REQUIRE(sweep.mean == Approx(TheoreticalAttackRate).margin(0.015));
+    REQUIRE(sweep.major == Approx(1 - 1 / 1.5).margin(0.08));
+}
+
+TEST_CASE("Binomial FOI mode only draws the people it infects", "[SIR]") {
+    auto perIndividual = [] (SIRSimulation &sir) {};
+    auto binomial = [] (SIRSimulation &sir) {
+        sir.SetFOIMode(FOIMode::Binomial);
+    };
+
+    for (unsigned int seed = 1; seed <= 20; seed++) {
+        int nSwept, nThinned;
+        RunStats swept   = StatsOfRun(seed, 2000, perIndividual, nSwept);
+        RunStats thinned = StatsOfRun(seed, 2000, binomial, nThinned);
+
+        // The first case aside, everyone infected was drawn, and everyone
+        //   drawn is infected unless the run ends first
+        REQUIRE(thinned.foiDraws + 1 >= (uint64_t)nThinned);
+        REQUIRE(thinned.foiDraws <= (uint64_t)nThinned + 2);
+
+        // The sweep draws for everyone still susceptible at each update
+        REQUIRE(swept.foiDraws >= (uint64_t)(2000 - nSwept));
+    }
+}
+
+TEST_CASE("Final size of each engine matches theory", "[SIR]") {
+    map<string, function<void(SIRSimulation &)>> engines = {
+        {"Adaptive", [] (SIRSimulation &sir) {
+            sir.SetAdaptiveFOIStep(0.5, 14, 0.3);
+        }},
+        {"Adaptive Hybrid", [] (SIRSimulation &sir) {
+            sir.SetRunMode(RunMode::Hybrid);
+            sir.SetHybridThresholds(200, 50);
+            sir.SetAdaptiveFOIStep(0.5, 14, 0.3);
+        }},
+        {"Adaptive Parallel", [] (SIRSimulation &sir) {
+            sir.SetRunMode(RunMode::Parallel);
+            sir.SetPartitions(4, 2);
+            sir.SetAdaptiveFOIStep(0.5, 14, 0.3);
+        }},
+        {"Binomial", [] (SIRSimulation &sir) {
+            sir.SetFOIMode(FOIMode::Binomial);
+        }},
+        {"Gillespie", [] (SIRSimulation &sir) {
+            sir.SetRunMode(RunMode::Gillespie);
+        }},
+        {"TauLeaping", [] (SIRSimulation &sir) {
+            sir.SetRunMode(RunMode::TauLeaping);
+        }},
+        {"Hybrid", [] (SIRSimulation &sir) {
+            sir.SetRunMode(RunMode::Hybrid);
+            sir.SetHybridThresholds(200, 50);
+        }},
+        {"Lazy", [] (SIRSimulation &sir) {
+            sir.SetLazyPopulation(true);
+        }},
+        {"Lazy Hybrid", [] (SIRSimulation &sir) {
+            sir.SetRunMode(RunMode::Hybrid);
+            sir.SetHybridThresholds(200, 50);
+            sir.SetLazyPopulation(true);
+        }},
+        {"Parallel", [] (SIRSimulation &sir) {
+            sir.SetRunMode(RunMode::Parallel);
+            sir.SetPartitions(4, 2);
+        }},
+        {"Parallel Binomial", [] (SIRSimulation &sir) {
+            sir.SetRunMode(RunMode::Parallel);
+            sir.SetFOIMode(FOIMode::Binomial);
+            sir.SetPartitions(4, 2);
+        }},
+    };
+
+    for (auto &engine : engines) {
+        INFO(engine.first);
+
+        AttackRate rate = MajorAttackRate(60, 10000, engine.second);
+
+        REQUIRE(rate.mean == Approx(TheoreticalAttackRate).margin(0.01));
+    }
+}
+
+TEST_CASE("Gillespie takes one step per infection or recovery", "[SIR]") {
+    for (unsigned int seed = 1; seed <= 20; seed++) {
+        RNG rng(seed);
+        SIRSimulation sir(&rng, 0.3, 5, 2000, 0, 100, 10, 400, 1, 10);
+
+        sir.SetRunMode(RunMode::Gillespie);
+        sir.Run();
+
+        int nInfections = sir.GetData<TimeSeries<int>>(SIRData::Infections)->GetTotal();
+        int nRecoveries = sir.GetData<TimeSeries<int>>(SIRData::Recoveries)->GetTotal();
+
+        // The first case is infected before the first step. There are no
+        //   FOI updates, and so no draws for susceptibles.
+        REQUIRE(sir.GetRunStats().gillespieSteps == (uint64_t)(nInfections - 1 + nRecoveries));
+        REQUIRE(sir.GetRunStats().foiDraws == 0);
+    }
+}
+
+TEST_CASE("Tau-leaps stay within the epsilon bound", "[SIR]") {
+    uint64_t looserLeaps = 0;
+
+    for (double epsilon : {0.1, 0.03, 0.01}) {
+        auto tauLeaping = [epsilon] (SIRSimulation &sir) {
+            sir.SetRunMode(RunMode::TauLeaping);
+            sir.SetTauLeapEpsilon(epsilon);
+        };
+
+        // Seed 1 gives a major outbreak, so most of the run is leaps
+        int nInfections;
+        RunStats stats = StatsOfRun(1, 100000, tauLeaping, nInfections);
+
+        REQUIRE(nInfections > 100000 / 10);
+        REQUIRE(stats.tauLeaps > 0);
+        REQUIRE(stats.maxLeapChange <= epsilon / 2 * (1 + 1e-9));
+        REQUIRE(stats.maxLeapTurnover <= epsilon * (1 + 1e-9));
+
+        // A tighter bound takes more, shorter leaps
+        REQUIRE(stats.tauLeaps > looserLeaps);
+        looserLeaps = stats.tauLeaps;
+    }
+}
+
+TEST_CASE("Tau-leaping epsilon out of range", "[SIR]") {
+    RNG *rng = new RNG(time(NULL));
+    SIRSimulation *sir =
+      new SIRSimulation(rng, 1, 1, 10, 0, 100, 10, 365, 1, 7);
+
+    REQUIRE_THROWS(sir->SetTauLeapEpsilon(0));
+    REQUIRE_THROWS(sir->SetTauLeapEpsilon(1));
+
+    delete sir;
+}
+
+TEST_CASE("Hybrid switches engines at its thresholds", "[SIR]") {
+    auto hybrid = [] (SIRSimulation &sir) {
+        sir.SetRunMode(RunMode::Hybrid);
+        sir.SetHybridThresholds(200, 50);
+    };
+    auto outOfReach = [] (SIRSimulation &sir) {
+        sir.SetRunMode(RunMode::Hybrid);
+        sir.SetHybridThresholds(20000, 50);
+    };
+
+    for (unsigned int seed = 1; seed <= 10; seed++) {
+        int nInfections;
+        RunStats stats = StatsOfRun(seed, 10000, hybrid, nInfections);
+        auto &handOvers = stats.handOvers;
+
+
+        // The engines alternate, starting with the individual engine, and
+        //   hand over as soon as the infectives cross the thresholds, give
+        //   or take the infections of the batch or leap crossing them
+        for (size_t i = 0; i < handOvers.size(); i++) {
+            REQUIRE(handOvers[i].toAggregate == (i % 2 == 0));
+            if (handOvers[i].toAggregate) {
+                REQUIRE(handOvers[i].nInfected >= 200);
+                REQUIRE(handOvers[i].nInfected < 250);
+            } else {
+                REQUIRE(handOvers[i].nInfected <= 50);
+                REQUIRE(handOvers[i].nInfected > 40);
+            }
+            if (i > 0)
+                REQUIRE(handOvers[i].t >= handOvers[i - 1].t);
+        }
+
+        // Leaping is only done between hand-overs, and a major outbreak
+        //   rises through both thresholds
+        REQUIRE((stats.tauLeaps > 0) == !handOvers.empty());
+        if (nInfections > 10000 / 10)
+            REQUIRE(handOvers.size() >= 2);
+
+        // Nothing switches below the upper threshold
+        stats = StatsOfRun(seed, 10000, outOfReach, nInfections);
+        REQUIRE(stats.handOvers.empty());
+        REQUIRE(stats.tauLeaps == 0);
+    }
+}
+
+TEST_CASE("Hybrid thresholds out of order", "[SIR]") {
+    RNG rng(1);
+    SIRSimulation sir(&rng, 1, 1, 10, 0, 100, 10, 365, 1, 7);
+
+    REQUIRE_THROWS(sir.SetHybridThresholds(50, 50));
+    REQUIRE_NOTHROW(sir.SetHybridThresholds(200, 50));
+}
+
+TEST_CASE("Lazy population only creates the people it infects", "[SIR]") {
+    auto full = [] (SIRSimulation &sir) {};
+    auto lazy = [] (SIRSimulation &sir) {
+        sir.SetLazyPopulation(true);
+    };
+    auto lazyHybrid = [] (SIRSimulation &sir) {
+        sir.SetRunMode(RunMode::Hybrid);
+        sir.SetHybridThresholds(200, 50);
+        sir.SetLazyPopulation(true);
+    };
+
+    for (unsigned int seed = 1; seed <= 10; seed++) {
+        int nInfections;
+
+        REQUIRE(StatsOfRun(seed, 10000, full, nInfections).peopleCreated == 10000);
+
+        // Everyone created is infected, unless the run ends first
+        RunStats stats = StatsOfRun(seed, 10000, lazy, nInfections);
+        REQUIRE(stats.peopleCreated >= (uint64_t)nInfections);
+        REQUIRE(stats.peopleCreated <= (uint64_t)nInfections + 2);
+
+        // The hybrid engine also creates the infectives it hands back, but
+        //   nobody infected by its leaps
+        stats = StatsOfRun(seed, 10000, lazyHybrid, nInfections);
+        REQUIRE(stats.peopleCreated <= (uint64_t)nInfections + 2);
+        if (!stats.handOvers.empty())
+            REQUIRE(stats.peopleCreated < (uint64_t)nInfections / 2);
+    }
+
+    // An outbreak that dies out in a large population creates few people
+    RNG rng(1);
+    SIRSimulation sir(&rng, 0.02, 5, 10000000, 0, 100, 10, 400, 1, 10);
+
+    sir.SetLazyPopulation(true);
+    sir.Run();
+
+    REQUIRE(sir.GetRunStats().peopleCreated < 100);
+}
+
+TEST_CASE("Calibration simulation records only infections", "[SIR]") {
+    RNG *rng = new RNG(time(NULL));
+    CalibrationSIRSimulation *sir =
+      new CalibrationSIRSimulation(rng, 5, 10, 10000, 0, 100, 10, 100, 1, 10);
+
+    sir->Run();
+
+    IncidenceTimeSeries<int> *Infections =
+      sir->GetData<IncidenceTimeSeries<int>>(SIRData::Infections);
+
+    REQUIRE(Infections != nullptr);
+    REQUIRE(Infections->GetTotalAtTime(0) > 0);
+    REQUIRE(sir->GetData<TimeSeries<int>>(SIRData::Susceptible) == nullptr);
+    REQUIRE(sir->GetData<TimeSeries<int>>(SIRData::Recoveries) == nullptr);
+
+    delete sir;
+}
+
+TEST_CASE("Output mask keeps only the selected datastores", "[SIR]") {
+    RNG *rng = new RNG(time(NULL));
+    SIRSimulation *sir =
+      new SIRSimulation(rng, 5, 10, 10000, 0, 100, 10, 100, 1, 10,
+                        SIRDataBit(SIRData::Infected) | SIRDataBit(SIRData::Infections));
+
+    sir->Run();
+
+    TimeSeries<int> *I_ts   = sir->GetData<TimeSeries<int>>(SIRData::Infected);
+    TimeSeries<int> *Inf_ts = sir->GetData<TimeSeries<int>>(SIRData::Infections);
+
+    REQUIRE(I_ts != nullptr);
+    REQUIRE(Inf_ts != nullptr);
+    REQUIRE(Inf_ts->GetTotalAtTime(0) > 0);
+    REQUIRE(sir->GetData<PyramidTimeSeries>(SIRData::Infected) != nullptr);
+    REQUIRE(sir->GetData<PyramidData<double>>(SIRData::Infections) != nullptr);
+
+    REQUIRE(sir->GetData<TimeSeries<int>>(SIRData::Susceptible) == nullptr);
+    REQUIRE(sir->GetData<TimeSeries<int>>(SIRData::Recovered) == nullptr);
+    REQUIRE(sir->GetData<TimeStatistic>(SIRData::Recoveries) == nullptr);
+    REQUIRE(sir->GetData<PyramidTimeSeries>(SIRData::Susceptible) == nullptr);
+
+    delete sir;
+}
+
+// Returns the change of every field in every period of a run with seed
+//   'seed' of a simulation of 'nPeople' people with R0 = 1.5
+template <typename Sim>
+static vector<int> PeriodTotals(unsigned int seed, unsigned int nPeople)
+{
+    RNG rng(seed);
+    Sim sir(&rng, 0.3, 5, nPeople, 0, 100, 10, 400, 1, 10);
+    vector<int> totals;
+
+    sir.Run();
+
+    const FullRecorder *recorder = sir.GetRecorder();
+    for (unsigned int p = 0; p < recorder->NumPeriods(); p++)
+        for (int field = 0; field < FullRecorder::nFields; field++)
+            totals.push_back(recorder->Total((SIRData)field, p));
+
+    return totals;
+}
+
+TEST_CASE("Radix queue simulation gives the calendar queue's run", "[SIR]") {
+    // Rounding times to ticks can only reorder events less than a tick
+    //   apart, which these runs do not have, so each seed gives the same run
+    for (unsigned int seed = 1; seed <= 10; seed++)
+        REQUIRE(PeriodTotals<RadixSIRSimulation>(seed, 5000) ==
+                PeriodTotals<SIRSimulation>(seed, 5000));
+}
+
+TEST_CASE("Threaded FOI sweep gives the same run for any number of threads", "[SIR]") {
+    // Enough people for several chunks of the sweep
+    const int nPeople = 200000;
+    vector<int> reference;
+
+    for (uint threads : {1, 2, 3, 8}) {
+        RNG *rng = new RNG(42);
+        SIRSimulation *sir =
+          new SIRSimulation(rng, 1, 5, nPeople, 0, 100, 10, 50, 1, 10);
+
+        sir->SetFOIThreads(threads);
+        sir->Run();
+
+        TimeSeries<int> *I_ts = sir->GetData<TimeSeries<int>>(SIRData::Infected);
+        TimeSeries<int> *R_ts = sir->GetData<TimeSeries<int>>(SIRData::Recovered);
+
+        vector<int> totals;
+        for (int t = 0; t < 50; t += 10) {
+            totals.push_back(I_ts->GetTotalAtTime(t));
+            totals.push_back(R_ts->GetTotalAtTime(t));
+        }
+
+        if (reference.empty())
+            reference = totals;
+        REQUIRE(totals == reference);
+
+        delete sir;
+        delete rng;
+    }
+}
+
+TEST_CASE("Parallel run ends at the recovery of the last infective", "[SIR]") {
+    FOIMode foiModes[] = {FOIMode::PerIndividual, FOIMode::Binomial};
+
+    for (auto foiMode : foiModes)
+        for (unsigned int seed = 1; seed <= 20; seed++) {
+            RNG rng(seed);
+            SIRSimulation sir(&rng, 0.3, 5, 2000, 0, 100, 10, 400, 5, 1);
+
+            sir.SetRunMode(RunMode::Parallel);
+            sir.SetFOIMode(foiMode);
+            sir.SetPartitions(4, 2);
+            sir.Run();
+
+            // The partitions run whole steps of several days, but what they
+            //   ran after the last recovery is discarded, so nobody is
+            //   infected after the day the infectives run out
+            const FullRecorder *recorder = sir.GetRecorder();
+            int  nInfected = 0;
+            bool extinct   = false;
+
+            for (unsigned int day = 0; day < recorder->NumPeriods(); day++) {
+                if (extinct)
+                    REQUIRE(recorder->Total(SIRData::Infections, day) == 0);
+
+                nInfected += recorder->Total(SIRData::Infected, day);
+                REQUIRE(nInfected >= 0);
+                extinct |= nInfected == 0;
+            }
+
+            REQUIRE(extinct);
+        }
+}
+
+TEST_CASE("Parallel run settings out of range", "[SIR]") {
+    RNG rng(1);
+    SIRSimulation sir(&rng, 1, 1, 10, 0, 100, 10, 365, 1, 7);
+
+    REQUIRE_THROWS(sir.SetPartitions(0, 1));
+    REQUIRE_THROWS(sir.SetPartitions(1, 0));
+
+    sir.SetRunMode(RunMode::Parallel);
+    sir.SetLazyPopulation(true);
+    REQUIRE_THROWS(sir.Run());
+}
+
+TEST_CASE("Parallel run gives the same run for any number of threads", "[SIR]") {
+    vector<int> reference;
+
+    for (uint threads : {1, 2, 5}) {
+        RNG *rng = new RNG(7);
+        SIRSimulation *sir =
+          new SIRSimulation(rng, 1, 5, 20000, 0, 100, 10, 50, 1, 10);
+
+        sir->SetRunMode(RunMode::Parallel);
+        sir->SetPartitions(5, threads);
+        sir->Run();
+
+        TimeSeries<int> *I_ts = sir->GetData<TimeSeries<int>>(SIRData::Infected);
+        TimeSeries<int> *R_ts = sir->GetData<TimeSeries<int>>(SIRData::Recovered);
+
+        vector<int> totals;
+        for (int t = 0; t < 50; t += 10) {
+            totals.push_back(I_ts->GetTotalAtTime(t));
+            totals.push_back(R_ts->GetTotalAtTime(t));
+        }
+
+        if (reference.empty())
+            reference = totals;
+        REQUIRE(totals == reference);
+
+        delete sir;
+        delete rng;
+    }
+}
+
+TEST_CASE("Adaptive FOI step follows the change in infectives", "[SIR]") {
+    auto adaptive = [] (SIRSimulation &sir) {
+        sir.SetAdaptiveFOIStep(0.5, 14, 0.3);
+    };
+
+    for (unsigned int seed = 1; seed <= 10; seed++) {
+        int nInfections;
+        RunStats stats = StatsOfRun(seed, 10000, adaptive, nInfections);
+        auto &steps    = stats.foiSteps;
+        int nShorter   = 0;
+        int nLonger    = 0;
+
+        // Each step is shorter than the last if the infectives changed by
+        //   more than the tolerance over it, and longer if by less, unless
+        //   at its bounds
+        for (size_t i = 1; i < steps.size(); i++) {
+            double change = fabs((double)steps[i].nInfected - (double)steps[i - 1].nInfected)
+                              / max((double)steps[i - 1].nInfected, 1.0);
+
+            REQUIRE(steps[i].t == Approx(steps[i - 1].t + steps[i - 1].length));
+            REQUIRE(steps[i].length >= 0.5);
+            REQUIRE(steps[i].length <= 14);
+
+            if (change > 0.3 && steps[i].length > 0.5) {
+                REQUIRE(steps[i].length < steps[i - 1].length);
+                nShorter++;
+            }
+            if (change < 0.3 && steps[i].length < 14) {
+                REQUIRE(steps[i].length > steps[i - 1].length);
+                nLonger++;
+            }
+        }
+
+        // A major outbreak speeds up and slows down
+        if (nInfections > 10000 / 10) {
+            REQUIRE(nShorter > 0);
+            REQUIRE(nLonger > 0);
+        }
+    }
+
+    // With one infective who neither recovers nor infects anyone, the step
+    //   grows to its longest and stays there
+    RNG rng(1);
+    SIRSimulation sir(&rng, 1e-9, 1e9, 1000, 0, 100, 10, 400, 1, 10);
+
+    sir.SetAdaptiveFOIStep(0.5, 14, 0.3);
+    sir.Run();
+
+    auto &flat = sir.GetRunStats().foiSteps;
+    REQUIRE(flat.back().length == 14);
+    REQUIRE(flat.size() < 400 / 14 + 6);
+}
+
+TEST_CASE("Adaptive FOI step out of range", "[SIR]") {
+    RNG rng(1);
+    SIRSimulation sir(&rng, 1, 1, 10, 0, 100, 10, 365, 1, 7);
+
+    REQUIRE_THROWS(sir.SetAdaptiveFOIStep(0, 7, 0.1));
+    REQUIRE_THROWS(sir.SetAdaptiveFOIStep(2, 1, 0.1));
+    REQUIRE_THROWS(sir.SetAdaptiveFOIStep(0.25, 7, 0));
+}
+
+TEST_CASE("Result block agrees with the time series built from it", "[SIR]") {
+    RNG rng(1);
+    SIRSimulation *sir =
+      new SIRSimulation(&rng, 5, 10, 10000, 0, 100, 10, 100, 1, 10);
+
+    REQUIRE_THROWS(sir->GetData<TimeSeries<int>>(SIRData::Infections));
+
+    sir->Run();
+
+    const FullRecorder *recorder = sir->GetRecorder();
+    TimeSeries<int> *Inf_ts = sir->GetData<TimeSeries<int>>(SIRData::Infections);
+
+    REQUIRE(recorder->NumPeriods() == 11);
+
+    int nPeople     = 0;
+    int nInfections = 0;
+    for (unsigned int p = 0; p < recorder->NumPeriods(); p++) {
+        nPeople += recorder->Total(SIRData::Susceptible, p)
+                 + recorder->Total(SIRData::Infected, p)
+                 + recorder->Total(SIRData::Recovered, p);
+        nInfections += recorder->Total(SIRData::Infections, p);
+
+        REQUIRE(recorder->Total(SIRData::Infections, p) == Inf_ts->GetTotalAtTime(p * 10));
+    }
+
+    REQUIRE(nPeople == 10000);
+    REQUIRE(nInfections == Inf_ts->GetTotal());
+
+    delete sir;
+}
+
+// Keeps the counts of the last period passed to it and sums its changes,
+//   checking that periods arrive in order and that every period counts
+//   'nPeople' people
+struct TotalsSink : public PeriodSink {
+    int nPeople;
+    unsigned int nPeriods = 0;
+    bool inOrder          = true;
+    bool everyoneCounted  = true;
+    int totals[5]         = {0, 0, 0, 0, 0};
+
+    TotalsSink(int nPeople) : nPeople(nPeople) {}
+
+    void ClosePeriod(unsigned int period, const int *periodTotals,
+                     const int *byAgeGroup, int nAgeGroups) override {
+        inOrder &= period == nPeriods++;
+        everyoneCounted &= periodTotals[0] + periodTotals[1] + periodTotals[2] == nPeople;
+        for (int field = 0; field < 3; field++)
+            totals[field] = periodTotals[field];
+        for (int field = 3; field < 5; field++)
+            totals[field] += periodTotals[field];
+    }
+};
+
+TEST_CASE("Streaming simulation passes every period to its sink", "[SIR]") {
+    RNG *rng = new RNG(time(NULL));
+    StreamingSIRSimulation *sir =
+      new StreamingSIRSimulation(rng, 5, 10, 10000, 0, 100, 10, 100, 1, 10);
+    TotalsSink sink(10000);
+
+    sir->GetRecorder()->SetSink(&sink);
+    sir->Run();
+
+    REQUIRE(sink.nPeriods == 11);
+    REQUIRE(sink.inOrder);
+    REQUIRE(sink.everyoneCounted);
+    REQUIRE(sink.totals[3] >= sink.totals[4]);
+    REQUIRE(sink.totals[1] + sink.totals[2] == sink.totals[3]);
+    REQUIRE(sir->GetData<TimeSeries<int>>(SIRData::Infections) == nullptr);
+
+    delete sir;
+}
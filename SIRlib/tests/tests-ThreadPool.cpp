@@ -0,0 +1,69 @@
+#include "catch.hpp"
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "../include/SIRlib/ThreadPool.h"
+
+using namespace std;
+using namespace SIRlib;
+
+TEST_CASE("Every index is visited once per loop", "[ThreadPool]") {
+    ThreadPool pool(3);
+
+    REQUIRE(pool.NumThreads() == 3);
+
+    for (unsigned int n : {0u, 1u, 2u, 3u, 7u, 100u}) {
+        vector<int> visits(n, 0);
+
+        pool.ParallelFor(n, [&] (unsigned int i) { visits[i]++; });
+
+        for (unsigned int i = 0; i < n; i++)
+            REQUIRE(visits[i] == 1);
+    }
+}
+
+TEST_CASE("Loops reuse the same threads", "[ThreadPool]") {
+    ThreadPool pool(4);
+    vector<thread::id> first(4), later(4);
+
+    pool.ParallelFor(4, [&] (unsigned int i) { first[i] = this_thread::get_id(); });
+    REQUIRE(first[0] == this_thread::get_id());
+
+    for (int loop = 0; loop < 50; loop++) {
+        pool.ParallelFor(4, [&] (unsigned int i) { later[i] = this_thread::get_id(); });
+        REQUIRE(later == first);
+    }
+}
+
+TEST_CASE("A loop returns once every call has returned", "[ThreadPool]") {
+    ThreadPool pool(4);
+    atomic<int> done(0);
+
+    for (int loop = 1; loop <= 50; loop++) {
+        pool.ParallelFor(16, [&] (unsigned int i) {
+            this_thread::yield();
+            done++;
+        });
+
+        REQUIRE(done == 16 * loop);
+    }
+}
+
+TEST_CASE("An exception in a call is rethrown by the loop", "[ThreadPool]") {
+    ThreadPool pool(2);
+
+    REQUIRE_THROWS_AS(pool.ParallelFor(8, [] (unsigned int i) {
+        if (i == 5)
+            throw out_of_range("i == 5");
+    }), out_of_range);
+
+    // The pool is still usable afterwards
+    atomic<int> done(0);
+    pool.ParallelFor(8, [&] (unsigned int i) { done++; });
+    REQUIRE(done == 8);
+
+    REQUIRE_THROWS(ThreadPool(0));
+}
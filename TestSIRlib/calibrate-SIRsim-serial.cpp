@@ -16,8 +16,6 @@
 #include <Calibrate.h>
 #include <PolyRegCal.hpp>
 
-#include "SIRSimRunner.h"
-
 using namespace SIRlib;
 using namespace ComputationalLib;
 using namespace SimulationLib;
@@ -81,9 +79,6 @@ using uint = unsigned int;
 //          ]
 //      }
 
-
-using RunType = SIRSimRunner::RunType;
-
 template <typename Num>
 Num toRange(Num v, Num low, Num high)
 {
@@ -160,27 +155,20 @@ int main(int argc, char const *argv[])
     // are lambda and gamma.
     using F = std::function<double(double,double)>;
     F f = [&] (double lambda, double gamma) -> double {
-        
-        auto S = SIRSimRunner(fileName, 
-                              1, 
-                              lambda, 
-                              gamma, 
-                              nPeople, 
-                              ageMin,
-                              ageMax, 
-                              ageBreak, 
-                              tMax, 
-                              deltaT,
-                              pLength);
-        
-        S.Run<RunType::Serial>(); // This will return a bool (succ/fail)
-        
-        // S.Write();
-        // ^ Uncomment for debug
-
-        // Only running one trajectory. Pull out number
-        // of infections per period ("pLength")
-        auto InfectionsModel = S.GetTrajectoryResult(0).Infections;
+
+        // Only running one trajectory, which needs nothing but the number of
+        // infections per period ("pLength"), so a calibration simulation is
+        // used in place of a full one
+        RNG masterRNG(42);
+        RNG rng(masterRNG.mt_());
+
+        CalibrationSIRSimulation S(&rng, lambda, gamma, nPeople, ageMin,
+                                   ageMax, ageBreak, tMax, deltaT, pLength);
+
+        S.Run(); // This will return a bool (succ/fail)
+
+        auto InfectionsModel =
+          S.GetData<IncidenceTimeSeries<int>>(SIRData::Infections);
 
         auto Likelihood = CalculateLikelihood(*InfectionsModel, 
                                               *InfectionsData, 